@@ -26,8 +26,13 @@
 #include "camgazebo_c_types.h"
 
 #include "codels.hpp"
+#include "label_codec.hpp"
 
+#include <algorithm>
+#include <cerrno>
 #include <condition_variable>
+#include <cstdlib>
+#include <cstring>
 #include <mutex>
 #include <chrono>
 #include <opencv2/opencv.hpp>
@@ -35,15 +40,275 @@ using namespace cv;
 
 
 /* --- Calib helper  ------------------------------------------------------ */
-void compute_calib(or_sensor_intrinsics* intr, float hfov, or_camera_info_size_s size)
+void compute_calib(or_sensor_intrinsics* intr, float hfov, or_camera_info_size_s size,
+                   camgazebo_projection model, const float kb[4])
 {
-    float f = size.w/2/tan(hfov/2);
+    float f = lens_focal(model, kb, hfov, size.w);
     intr->calib = {
         f, f, (float)size.w/2, (float)size.h/2, 0
     };
 }
 
 
+/* --- Reprojection helper ------------------------------------------------ */
+static void update_reproj(camgazebo_reproj_s* reproj, camgazebo_projection proj_lens,
+                          camgazebo_projection proj_out, const float kb[4], float hfov,
+                          or_camera_info_size_s size)
+{
+    if (!reproj->dirty && reproj->w == size.w && reproj->h == size.h)
+        return;
+    reproj->dirty = false;
+    reproj->w = size.w;
+    reproj->h = size.h;
+
+    // both models share the principal point and field of view
+    lens in = { proj_lens, { kb[0], kb[1], kb[2], kb[3] },
+                lens_focal(proj_lens, kb, hfov, size.w), (float)size.w/2, (float)size.h/2 };
+    lens out = { proj_out, { kb[0], kb[1], kb[2], kb[3] },
+                 lens_focal(proj_out, kb, hfov, size.w), (float)size.w/2, (float)size.h/2 };
+
+    std::vector<float> map_x, map_y;
+    reprojection_maps(in, out, size.w, size.h, map_x, map_y);
+
+    convertMaps(
+        Mat(size.h, size.w, CV_32FC1, map_x.data()),
+        Mat(size.h, size.w, CV_32FC1, map_y.data()),
+        reproj->map1, reproj->map2, CV_16SC2
+    );
+}
+
+
+/* --- Exposure timing helpers ------------------------------------------- */
+
+// the row table only depends on the format and exposure settings
+static int update_timing(camgazebo_frame_timing* timing, uint16_t h,
+                         float exposure, float line_readout)
+{
+    if (h > timing->row_mid._maximum)
+        if (genom_sequence_reserve(&(timing->row_mid), h) == -1)
+            return -1;
+    timing->row_mid._length = h;
+    for (uint16_t r = 0; r < h; r++)
+        timing->row_mid._buffer[r] = r * line_readout + exposure / 2;
+
+    timing->exposure = exposure;
+    timing->line_readout = line_readout;
+    return 0;
+}
+
+/* --- Frame port helpers ---------------------------------------------- */
+
+// size the frame ports for published images of w x h pixels of bpp bytes
+static int size_frame_ports(const camgazebo_frame* frame, uint16_t w, uint16_t h,
+                            uint16_t bpp, const frame_memory& mem,
+                            const genom_context self)
+{
+    or_sensor_frame* rfdata = frame->data("raw", self);
+    uint64_t l = (uint64_t)w * h * bpp;
+
+    if (genom_sequence_reserve(&(rfdata->pixels), l) == -1)
+        return -1;
+    frame_advise(rfdata->pixels._buffer, l, mem.pages, mem.node);
+    rfdata->pixels._length = l;
+    rfdata->height = h;
+    rfdata->width = w;
+    rfdata->bpp = bpp;
+
+    or_sensor_frame* cfdata = frame->data("compressed", self);
+    (void)genom_sequence_reserve(&(cfdata->pixels), 0);
+    cfdata->pixels._length = 0;
+    cfdata->height = h;
+    cfdata->width = w;
+    cfdata->bpp = bpp;
+    return 0;
+}
+
+static or_time_ts ts_add(const or_time_ts& ts, double sec)
+{
+    int64_t ns = (int64_t)ts.sec * 1000000000 + ts.nsec + (int64_t)std::llround(sec * 1e9);
+    return { (int32_t)(ns / 1000000000), (int32_t)(ns % 1000000000) };
+}
+
+
+/* --- Optional output helpers ------------------------------------------ */
+
+// Each helper publishes one optional output of the raw frame, and returns
+// genom_ok or the exception to throw.
+
+// frames are appended to the batch and written as a whole; a format
+// change, or batching being turned off, writes a partial batch
+static genom_event write_batch(const camgazebo_batch* batch, uint16_t batch_size,
+                               const frame_view& raw, const or_time_ts& ts,
+                               uint32_t seq, const genom_context self)
+{
+    camgazebo_frame_batch* bdata = batch->data(self);
+
+    if (bdata->index._length
+        && (!batch_size || bdata->width != raw.w || bdata->height != raw.h || bdata->bpp != raw.bpp()))
+    {
+        batch->write(self);
+        bdata->index._length = 0;
+    }
+    if (!batch_size)
+        return genom_ok;
+    if (!bdata->index._length)
+    {
+        bdata->width = raw.w;
+        bdata->height = raw.h;
+        bdata->bpp = raw.bpp();
+        bdata->pixels._length = 0;
+    }
+
+    uint64_t l = raw.size();
+    if (batch_size > bdata->index._maximum)
+        if (genom_sequence_reserve(&(bdata->index), batch_size) == -1) {
+            camgazebo_e_mem_detail d;
+            snprintf(d.what, sizeof(d.what), "unable to allocate batch memory");
+            warnx("%s", d.what);
+            return camgazebo_e_mem(&d,self);
+        }
+    if (batch_size * l > bdata->pixels._maximum)
+        if (genom_sequence_reserve(&(bdata->pixels), batch_size * l) == -1) {
+            camgazebo_e_mem_detail d;
+            snprintf(d.what, sizeof(d.what), "unable to allocate batch memory");
+            warnx("%s", d.what);
+            return camgazebo_e_mem(&d,self);
+        }
+
+    camgazebo_batch_entry* e = &bdata->index._buffer[bdata->index._length++];
+    e->ts = ts;
+    e->seq = seq;
+    e->offset = bdata->pixels._length;
+    e->length = l;
+    memcpy(bdata->pixels._buffer + e->offset, raw.data, l);
+    bdata->pixels._length += l;
+
+    if (bdata->index._length >= batch_size)
+    {
+        batch->write(self);
+        bdata->index._length = 0;
+    }
+    return genom_ok;
+}
+
+// the row table is up to date, only stamps change
+static void write_timing(const camgazebo_timing* timing, const or_time_ts& ts,
+                         uint16_t h, const genom_context self)
+{
+    camgazebo_frame_timing* tdata = timing->data(self);
+    if (tdata->exposure <= 0 && tdata->line_readout <= 0)
+        return;
+
+    tdata->ts = ts;
+    tdata->exposure_start = ts;
+    tdata->exposure_end = ts_add(ts, (h - 1) * tdata->line_readout + tdata->exposure);
+    tdata->exposure_mid = ts_add(ts, ((h - 1) * tdata->line_readout + tdata->exposure) / 2);
+    timing->write(self);
+}
+
+// only written when a tile changed, or for a keyframe
+static genom_event write_tiles(camgazebo_tiler_s* tiler, const camgazebo_tiles* tiles,
+                               const frame_view& raw, const pixel_pipeline& pipeline,
+                               const or_time_ts& ts, const genom_context self)
+{
+    camgazebo_tile_update* udata = tiles->data(self);
+
+    int r = tiler->update(raw, pipeline, udata);
+    if (r == -1) {
+        camgazebo_e_mem_detail d;
+        snprintf(d.what, sizeof(d.what), "unable to allocate tile memory");
+        warnx("%s", d.what);
+        return camgazebo_e_mem(&d,self);
+    }
+    if (r == 1)
+    {
+        udata->ts = ts;
+        tiles->write(self);
+    }
+    return genom_ok;
+}
+
+// detections run in the background and are published one frame late
+static genom_event write_tags(camgazebo_fiducial_s* fiducial, const camgazebo_tags* tags,
+                              const frame_view& raw, const or_sensor_intrinsics* intr,
+                              camgazebo_projection proj_out, const float proj_kb[4],
+                              const or_time_ts& ts, const genom_context self)
+{
+    if (fiducial->ready())
+    {
+        if (!fiducial->fetch(tags->data(self))) {
+            camgazebo_e_mem_detail d;
+            snprintf(d.what, sizeof(d.what), "unable to allocate detection memory");
+            warnx("%s", d.what);
+            return camgazebo_e_mem(&d,self);
+        }
+        tags->write(self);
+    }
+    if (fiducial->enabled && raw.d == 1)
+    {
+        if (fiducial->busy())
+            fiducial->skipped++;
+        else
+            fiducial->start(raw, intr, proj_out, proj_kb, ts);
+    }
+    return genom_ok;
+}
+
+// written once per frame, in the preallocated tensor
+static genom_event write_tensor(camgazebo_tensorizer_s* tensorizer, const camgazebo_tensor* tensor,
+                                const frame_view& raw, const or_time_ts& ts,
+                                const genom_context self)
+{
+    camgazebo_tensor_frame* ndata = tensor->data(self);
+
+    if (!tensorizer->update(raw, ndata)) {
+        camgazebo_e_mem_detail d;
+        snprintf(d.what, sizeof(d.what), "unable to allocate tensor memory");
+        warnx("%s", d.what);
+        return camgazebo_e_mem(&d,self);
+    }
+    ndata->ts = ts;
+    tensor->write(self);
+    return genom_ok;
+}
+
+// the point cloud is paced by the camera frames and uses the latest depth
+static genom_event write_cloud(camgazebo_depth_s* depth, const camgazebo_cloud* cloud,
+                               const frame_view& raw, const pixel_pipeline* pipeline,
+                               const or_sensor_intrinsics* intrinsics, float hfov,
+                               const float proj_kb[4], const genom_context self)
+{
+    camgazebo_pointcloud* pcdata = cloud->data(self);
+    uint32_t stride = depth->rgb ? 4 : 3;
+    uint64_t n = depth->fw * depth->fh;
+
+    // rays derive from the component calibration at the depth image size
+    or_sensor_intrinsics intr = *intrinsics;
+    compute_calib(&intr, hfov, { depth->fw, depth->fh }, camgazebo_proj_pinhole, proj_kb);
+    depth->update_rays(&intr);
+
+    if (n * stride + 1 > pcdata->points._maximum)
+        if (genom_sequence_reserve(&(pcdata->points), n * stride + 1) == -1) {
+            camgazebo_e_mem_detail d;
+            snprintf(d.what, sizeof(d.what), "unable to allocate point cloud memory");
+            warnx("%s", d.what);
+            return camgazebo_e_mem(&d,self);
+        }
+
+    const uint8_t* color = NULL;
+    if (raw.w == depth->fw && raw.h == depth->fh)
+        color = raw.data;
+
+    pcdata->npoints = depth->compute(color, pipeline, pcdata->points._buffer);
+    pcdata->points._length = pcdata->npoints * stride;
+    pcdata->rgb = depth->rgb;
+    pcdata->ts = depth->fts;
+
+    cloud->write(self);
+    return genom_ok;
+}
+
+
 /* --- Task main -------------------------------------------------------- */
 
 
@@ -56,30 +321,63 @@ genom_event
 camgz_start(camgazebo_ids *ids, const camgazebo_frame *frame,
             const camgazebo_extrinsics *extrinsics,
             const camgazebo_intrinsics *intrinsics,
-            const genom_context self)
+            const camgazebo_lens *lens, const genom_context self)
 {
     ids->info.started = false;
 
     // These are the defaults values for the gazebo camera
     ids->hfov = 1.047;
+    ids->exposure = 0;
+    ids->line_readout = 0;
     ids->info.size = {320, 240};
     snprintf(ids->info.format, sizeof(char)*8, "Y8");
     ids->info.compression_rate = -1;
+    ids->label_codec = camgazebo_codec_none;
+    ids->batch_size = 0;
+    ids->batch_exclusive = false;
+    ids->proj_lens = camgazebo_proj_pinhole;
+    ids->proj_out = camgazebo_proj_pinhole;
+    for (int i = 0; i < 4; i++)
+        ids->proj_kb[i] = 0;
 
     ids->data = new or_camera_data(ids->info.size.w, ids->info.size.h, 3);
     ids->pipe = new or_camera_pipe();
+    ids->stereo = new camgazebo_stereo_s();
+    ids->depth = new camgazebo_depth_s();
+    ids->reproj = new camgazebo_reproj_s();
+    ids->exporter = new camgazebo_exporter_s();
+    ids->logger = new camgazebo_logger_s();
+    ids->frames = new camgazebo_frames_s();
+    ids->frames->pipeline.reset(make_pixel_pipeline(ids->data->c, ids->data->d));
+    ids->latency = new camgazebo_latency_s();
+    ids->fanout = new camgazebo_fanout_s();
+    ids->motion = new camgazebo_motion_s();
+    ids->tiler = new camgazebo_tiler_s();
+    ids->sensor = new camgazebo_sensor_s();
+    ids->tensorizer = new camgazebo_tensorizer_s();
+    ids->fiducial = new camgazebo_fiducial_s();
+
+    isa_select(camgazebo_isa_auto);
+    warnx("using %s image kernels", isa_name(kernels.isa));
 
     // Publish initial calibration
-    compute_calib(intrinsics->data(self), ids->hfov, ids->info.size);
+    compute_calib(intrinsics->data(self), ids->hfov, ids->info.size, ids->proj_out, ids->proj_kb);
     intrinsics->data(self)->disto = {0,0,0,0,0};
     *extrinsics->data(self) = {0,0,0,0,0,0};
 
+    *lens->data(self) = { camgazebo_proj_pinhole, {0,0,0,0} };
+
     intrinsics->write(self);
     extrinsics->write(self);
+    lens->write(self);
 
     // Init frame ports
     frame->open("raw", self);
     frame->open("compressed", self);
+    frame->open("labels", self);
+    frame->open("left", self);
+    frame->open("right", self);
+    frame->open("disparity", self);
 
     if (genom_sequence_reserve(&(frame->data("raw", self)->pixels), ids->data->l) == -1) {
         camgazebo_e_mem_detail d;
@@ -107,15 +405,30 @@ camgz_start(camgazebo_ids *ids, const camgazebo_frame *frame,
 /** Codel camgz_wait of task main.
  *
  * Triggered by camgazebo_wait.
- * Yields to camgazebo_pause_wait, camgazebo_wait, camgazebo_pub.
+ * Yields to camgazebo_pause_wait, camgazebo_wait, camgazebo_pub,
+ *        camgazebo_pub_stereo.
  */
 genom_event
 camgz_wait(bool started, or_camera_data **data,
-           const genom_context self)
+           camgazebo_stereo_s **stereo, const genom_context self)
 {
     if (!started)
         return camgazebo_pause_wait;
 
+    if ((*stereo)->enabled)
+    {
+        std::unique_lock<std::mutex> lock((*stereo)->m);
+
+        if (!(*stereo)->match())
+        {
+            (*stereo)->cv.wait_for(lock, std::chrono::duration<int16_t>(camgazebo_poll_duration_sec));
+
+            if (!(*stereo)->match())
+                return camgazebo_wait;
+        }
+        return camgazebo_pub_stereo;
+    }
+
     std::unique_lock<std::mutex> lock((*data)->m);
 
     if (!(*data)->new_frame)
@@ -135,14 +448,69 @@ camgz_wait(bool started, or_camera_data **data,
  * Yields to camgazebo_wait.
  */
 genom_event
-camgz_pub(int16_t compression_rate, or_camera_data **data,
-          const camgazebo_frame *frame, const genom_context self)
+camgz_pub(int16_t compression_rate, camgazebo_codec label_codec,
+          or_camera_data **data,
+          const camgazebo_frame *frame, float hfov,
+          camgazebo_projection proj_lens, camgazebo_projection proj_out,
+          const float proj_kb[4], camgazebo_reproj_s **reproj,
+          camgazebo_depth_s **depth, camgazebo_exporter_s **exporter,
+          camgazebo_logger_s **logger, camgazebo_frames_s **frames,
+          camgazebo_latency_s **latency, camgazebo_fanout_s **fanout,
+          camgazebo_motion_s **motion, camgazebo_tiler_s **tiler,
+          camgazebo_tensorizer_s **tensorizer,
+          camgazebo_fiducial_s **fiducial, uint16_t batch_size,
+          bool batch_exclusive,
+          const camgazebo_intrinsics *intrinsics,
+          const camgazebo_extrinsics *extrinsics,
+          const camgazebo_cloud *cloud, const camgazebo_batch *batch,
+          const camgazebo_timing *timing, const camgazebo_tiles *tiles,
+          const camgazebo_tensor *tensor, const camgazebo_tags *tags,
+          const genom_context self)
 {
     or_sensor_frame* rfdata = frame->data("raw", self);
 
+    if (proj_lens != proj_out)
+        update_reproj(*reproj, proj_lens, proj_out, proj_kb, hfov, { rfdata->width, rfdata->height });
+
     std::unique_lock<std::mutex> lock((*data)->m);
+    auto taken = camgazebo_latency_s::clock::now();
+    auto arrival = (*data)->arrival;
+    auto ready = (*data)->ready;
+
+    const pixel_pipeline* pipeline = (*frames)->pipeline.get();
+    frame_view src = (*data)->view();
+    frame_view raw = frame_view::of(rfdata, src.c, src.d);
+
+    // unchanged frames are released without being copied
+    if ((*motion)->enabled && !(*motion)->changed(src))
+    {
+        (*data)->new_frame = false;
+        lock.unlock();
+        (*data)->cv.notify_all();
+        return camgazebo_wait;
+    }
+
+    // frames rendered larger than published are downsampled first
+    area_resampler& resampler = (*frames)->resampler;
+    if (resampler.active)
+    {
+        frame_view out = raw;
+        if (proj_lens != proj_out)
+            out = frame_view(resampler.scratch.data(), raw.w, raw.h, raw.c, raw.d, frame_view::scratch);
+        pipeline->resample(resampler, src, out);
+        src = out;
+    }
 
-    memcpy(rfdata->pixels._buffer, (*data)->data, rfdata->pixels._length); // sizeof *rfdata->pixels._buffer == 1
+    if (proj_lens != proj_out)
+        pipeline->reproject(src, raw, (*reproj)->map1, (*reproj)->map2);
+    else if (!resampler.active)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        src.copy_to(raw);
+        (*frames)->copy_sec += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        (*frames)->copy_bytes += src.size();
+        (*frames)->copies++;
+    }
 
     rfdata->ts.sec = (*data)->tv.tv_sec;
     rfdata->ts.nsec = (*data)->tv.tv_usec * 1000;
@@ -151,25 +519,29 @@ camgz_pub(int16_t compression_rate, or_camera_data **data,
     lock.unlock();
     (*data)->cv.notify_all();
 
-    frame->write("raw", self);
+    uint32_t seq = (*frames)->seq++;
 
-    if (compression_rate != -1)
-    {
-        or_sensor_frame* cfdata = frame->data("compressed", self);
+    genom_event e = write_batch(batch, batch_size, raw, rfdata->ts, seq, self);
+    if (e != genom_ok)
+        return e;
 
-        Mat cvframe = Mat(
-            Size(rfdata->width, rfdata->height),
-            rfdata->bpp == 1 ? CV_8UC1 : CV_8UC3,
-            rfdata->pixels._buffer,
-            Mat::AUTO_STEP
-        );
+    if ((!batch_size || !batch_exclusive) && !((*fiducial)->enabled && (*fiducial)->exclusive))
+        frame->write("raw", self);
+
+    write_timing(timing, rfdata->ts, raw.h, self);
+    auto written = camgazebo_latency_s::clock::now();
+
+    // every stage below reads the raw port buffer
+    Mat cvframe = raw.mat();
+    std::vector<uint8_t>& buf = (*frames)->encoded;
+    buf.clear();
 
-        std::vector<int32_t> compression_params;
-        compression_params.push_back(IMWRITE_JPEG_QUALITY);
-        compression_params.push_back(compression_rate);
+    if (compression_rate != -1 && pipeline->jpeg)
+    {
+        or_sensor_frame* cfdata = frame->data("compressed", self);
 
-        std::vector<uint8_t> buf;
-        imencode(".jpg", cvframe, buf, compression_params);
+        (*frames)->jpeg_params = { IMWRITE_JPEG_QUALITY, compression_rate };
+        imencode(".jpg", cvframe, buf, (*frames)->jpeg_params);
 
         if (buf.size() > cfdata->pixels._maximum)
             if (genom_sequence_reserve(&(cfdata->pixels), buf.size())  == -1) {
@@ -186,10 +558,208 @@ camgz_pub(int16_t compression_rate, or_camera_data **data,
         frame->write("compressed", self);
     }
 
+    if ((*tiler)->enabled)
+    {
+        e = write_tiles(*tiler, tiles, raw, *pipeline, rfdata->ts, self);
+        if (e != genom_ok)
+            return e;
+    }
+
+    e = write_tags(*fiducial, tags, raw, intrinsics->data(self), proj_out, proj_kb, rfdata->ts, self);
+    if (e != genom_ok)
+        return e;
+
+    // 16 bits images are labels, not network inputs
+    if ((*tensorizer)->enabled && raw.d == 1)
+    {
+        e = write_tensor(*tensorizer, tensor, raw, rfdata->ts, self);
+        if (e != genom_ok)
+            return e;
+    }
+
+    if (label_codec != camgazebo_codec_none)
+    {
+        or_sensor_frame* lfdata = frame->data("labels", self);
+        uint64_t n = (uint64_t)raw.w * raw.h;
+        uint64_t bound = label_encode_bound(n, raw.bpp());
+
+        if (bound > lfdata->pixels._maximum)
+            if (genom_sequence_reserve(&(lfdata->pixels), bound) == -1) {
+                camgazebo_e_mem_detail d;
+                snprintf(d.what, sizeof(d.what), "unable to allocate frame memory");
+                warnx("%s", d.what);
+                return camgazebo_e_mem(&d,self);
+            }
+
+        size_t len = 0;
+        if (label_codec == camgazebo_codec_palette)
+            len = pipeline->encode_labels(label_palette, raw.data, n, lfdata->pixels._buffer);
+        // more than 256 labels, fall back to plain runs
+        if (!len)
+            len = pipeline->encode_labels(label_rle, raw.data, n, lfdata->pixels._buffer);
+
+        lfdata->pixels._length = len;
+        lfdata->height = raw.h;
+        lfdata->width = raw.w;
+        lfdata->bpp = raw.bpp();
+        lfdata->compressed = true;
+        lfdata->ts = rfdata->ts;
+
+        frame->write("labels", self);
+    }
+
+    // logged from the port buffers, before buf is handed over to the exporter
+    if ((*logger)->running)
+    {
+        if ((*logger)->raw)
+            (*logger)->push_frame(rfdata, false, raw.data, raw.size());
+        if ((*logger)->compressed && !buf.empty())
+            (*logger)->push_frame(rfdata, true, buf.data(), buf.size());
+        (*logger)->push_calib(rfdata, intrinsics->data(self), extrinsics->data(self), proj_out, proj_kb);
+    }
+
+    // reuse the compressed frame if any, 16 bits images are stored as png
+    if ((*exporter)->running)
+    {
+        if (buf.empty())
+        {
+            (*frames)->jpeg_params.clear();
+            if (pipeline->jpeg)
+                (*frames)->jpeg_params = { IMWRITE_JPEG_QUALITY, 95 };
+            imencode(pipeline->export_ext, cvframe, buf, (*frames)->jpeg_params);
+        }
+        (*exporter)->push(buf, pipeline->export_ext, rfdata, intrinsics->data(self), extrinsics->data(self),
+                          proj_out, proj_kb);
+    }
+
+    (*fanout)->push(raw, rfdata->ts, seq);
+
+    (*latency)->record(rfdata->ts, arrival, ready, taken, written, camgazebo_latency_s::clock::now());
+
+    if ((*depth)->enabled && (*depth)->fetch())
+    {
+        e = write_cloud(*depth, cloud, raw, pipeline, intrinsics->data(self), hfov, proj_kb, self);
+        if (e != genom_ok)
+            return e;
+    }
+
+    return camgazebo_wait;
+}
+
+
+/** Codel camgz_pub_stereo of task main.
+ *
+ * Triggered by camgazebo_pub_stereo.
+ * Yields to camgazebo_wait.
+ */
+genom_event
+camgz_pub_stereo(const or_camera_info_size_s *size,
+                 camgazebo_stereo_s **stereo, const camgazebo_frame *frame,
+                 const camgazebo_intrinsics *intrinsics,
+                 const camgazebo_extrinsics *extrinsics,
+                 const genom_context self)
+{
+    camgazebo_stereo_s::side* side[2] = { (*stereo)->left.front(), (*stereo)->right.front() };
+    const char* name[2] = { "left", "right" };
+    uint16_t c = side[0]->pixels.size() / (size->w * size->h);
+
+    // maps only depend on the calibration, they are rebuilt when the
+    // calibration or the format is set
+    if ((*stereo)->rectify && (*stereo)->update_maps(intrinsics->data(self), extrinsics->data(self), size->w, size->h))
+        warnx("rebuilt stereo rectification maps");
+
+    // both frames of the pair share the mean of their sim stamps
+    int64_t ns = ((int64_t)side[0]->sec * 1000000000 + side[0]->nsec
+                + (int64_t)side[1]->sec * 1000000000 + side[1]->nsec) / 2;
+    or_time_ts ts = { (int32_t)(ns / 1000000000), (int32_t)(ns % 1000000000) };
+
+    for (int i = 0; i < 2; i++)
+    {
+        or_sensor_frame* fdata = frame->data(name[i], self);
+        uint64_t l = side[i]->pixels.size();
+
+        if (l > fdata->pixels._maximum)
+            if (genom_sequence_reserve(&(fdata->pixels), l) == -1) {
+                camgazebo_e_mem_detail d;
+                snprintf(d.what, sizeof(d.what), "unable to allocate frame memory");
+                warnx("%s", d.what);
+                return camgazebo_e_mem(&d,self);
+            }
+        fdata->pixels._length = l;
+        fdata->height = size->h;
+        fdata->width = size->w;
+        fdata->bpp = c;
+        fdata->compressed = false;
+
+        if ((*stereo)->rectify)
+            (*stereo)->remap(i, side[i]->pixels.data(), fdata->pixels._buffer, size->w, size->h, c);
+        else
+            memcpy(fdata->pixels._buffer, side[i]->pixels.data(), l); // sizeof *fdata->pixels._buffer == 1
+        fdata->ts = ts;
+    }
+
+    (*stereo)->left.pop();
+    (*stereo)->right.pop();
+    (*stereo)->pairs++;
+
+    frame->write("left", self);
+    frame->write("right", self);
+
+    // disparity is computed in the background and published one pair late
+    if ((*stereo)->disparity_ready())
+    {
+        or_sensor_frame* ddata = frame->data("disparity", self);
+        const cv::Mat& disp = (*stereo)->disp_out;
+        uint64_t l = disp.total() * disp.elemSize();
+
+        if (l > ddata->pixels._maximum)
+            if (genom_sequence_reserve(&(ddata->pixels), l) == -1) {
+                camgazebo_e_mem_detail d;
+                snprintf(d.what, sizeof(d.what), "unable to allocate frame memory");
+                warnx("%s", d.what);
+                return camgazebo_e_mem(&d,self);
+            }
+        ddata->pixels._length = l;
+        ddata->height = disp.rows;
+        ddata->width = disp.cols;
+        ddata->bpp = disp.elemSize();   // CV_16S, fixed-point with 4 fractional bits
+        ddata->compressed = false;
+
+        memcpy(ddata->pixels._buffer, disp.data, l); // sizeof *ddata->pixels._buffer == 1
+        ddata->ts = (*stereo)->disp_ts;
+
+        (*stereo)->disp_busy = false;
+        frame->write("disparity", self);
+    }
+
+    if ((*stereo)->disparity && !(*stereo)->disp_busy)
+        (*stereo)->start_disparity(
+            frame->data("left", self)->pixels._buffer,
+            frame->data("right", self)->pixels._buffer,
+            size->w, size->h, c, ts
+        );
+
     return camgazebo_wait;
 }
 
 
+// update rate matching the sim time schedule, 0 to keep the sdf one
+static double
+sensor_rate(const or_camera_data& data)
+{
+    return data.sim_period > 0 ? 1 / data.sim_period : 0;
+}
+
+// set the gazebo client up once, it stays up until disconnect()
+static bool
+transport_up(or_camera_pipe* pipe)
+{
+    if (!pipe->transport)
+        pipe->transport = gazebo::client::setup();
+    return pipe->transport;
+}
+
+
 /* --- Activity connect ------------------------------------------------- */
 
 /** Codel camgz_connect of activity connect.
@@ -199,7 +769,7 @@ camgz_pub(int16_t compression_rate, or_camera_data **data,
  */
 genom_event
 camgz_connect(const char topic[256], or_camera_data **data,
-              or_camera_pipe **pipe,
+              or_camera_pipe **pipe, camgazebo_sensor_s **sensor,
               const camgazebo_intrinsics *intrinsics, bool *started,
               const genom_context self)
 {
@@ -207,14 +777,21 @@ camgz_connect(const char topic[256], or_camera_data **data,
         warnx("already connected to gazebo, disconnect() first");
     else
     {
-        gazebo::client::setup();
+        transport_up(*pipe);
         (*pipe)->node = gazebo::transport::NodePtr(new gazebo::transport::Node());
         (*pipe)->node->Init();
 
         std::lock_guard<std::mutex> guard((*data)->m);
 
+        (*data)->next_slot = 0;
+        (*pipe)->topic = topic;
         (*pipe)->sub = (*pipe)->node->Subscribe(topic, &or_camera_data::cb, *data);
 
+        if (!(*sensor)->attach((*pipe)->node, topic))
+            warnx("no sensor name in %s, sensor control unavailable", topic);
+        else if ((*sensor)->enabled)
+            (*sensor)->request(true, sensor_rate(**data));
+
         warnx("connected to %s", topic);
         *started = true;
     }
@@ -223,188 +800,1059 @@ camgz_connect(const char topic[256], or_camera_data **data,
 }
 
 
-/* --- Activity disconnect ---------------------------------------------- */
+/* --- Activity list_cameras -------------------------------------------- */
 
-/** Codel camgz_disconnect of activity disconnect.
+/** Codel camgz_list_cameras of activity list_cameras.
  *
  * Triggered by camgazebo_start.
  * Yields to camgazebo_ether.
+ * Throws camgazebo_e_io.
  */
 genom_event
-camgz_disconnect(or_camera_data **data, bool *started,
-                 const genom_context self)
+camgz_list_cameras(double probe_timeout,
+                   sequence64_camgazebo_camera_topic *cameras,
+                   or_camera_pipe **pipe, const genom_context self)
 {
-    std::lock_guard<std::mutex> guard((*data)->m);
-
-    gazebo::client::shutdown();
-    *started = false;
+    // the master is queried through the transport layer, left up for a
+    // later connect()
+    if (!transport_up(*pipe))
+    {
+        camgazebo_e_io_detail d;
+        snprintf(d.what, sizeof(d.what), "%s", "cannot reach gazebo master");
+        warnx("io error: %s", d.what);
+        return camgazebo_e_io(&d,self);
+    }
 
-    warnx("disconnected from gazebo");
+    list_camera_topics(cameras, probe_timeout);
 
+    warnx("found %u cameras", cameras->_length);
     return camgazebo_ether;
 }
 
 
-/* --- Activity get_K --------------------------------------------------- */
+/* --- Activity connect_stereo ------------------------------------------ */
 
-/** Codel camgz_get_K of activity get_K.
+/** Codel camgz_connect_stereo of activity connect_stereo.
  *
  * Triggered by camgazebo_start.
  * Yields to camgazebo_ether.
  */
 genom_event
-camgz_get_K(const camgazebo_intrinsics *intrinsics, sequence5_float *K,
-            const genom_context self)
+camgz_connect_stereo(const char left_topic[256],
+                     const char right_topic[256], double tolerance,
+                     or_camera_data **data, or_camera_pipe **pipe,
+                     camgazebo_stereo_s **stereo, bool *started,
+                     const genom_context self)
 {
-    K->_length = 5;
-    K->_buffer[0] = intrinsics->data(self)->calib.fx;
-    K->_buffer[1] = intrinsics->data(self)->calib.fy;
-    K->_buffer[2] = intrinsics->data(self)->calib.cx;
-    K->_buffer[3] = intrinsics->data(self)->calib.cy;
-    K->_buffer[4] = intrinsics->data(self)->calib.gamma;
+    if (*started)
+        warnx("already connected to gazebo, disconnect() first");
+    else
+    {
+        transport_up(*pipe);
+        (*pipe)->node = gazebo::transport::NodePtr(new gazebo::transport::Node());
+        (*pipe)->node->Init();
+
+        (*stereo)->l = (*data)->l;
+        (*stereo)->tolerance = tolerance;
+        (*stereo)->pairs = 0;
+        (*stereo)->unmatched_left = 0;
+        (*stereo)->unmatched_right = 0;
+        (*stereo)->enabled = true;
+
+        (*stereo)->sub_left = (*pipe)->node->Subscribe(left_topic, &camgazebo_stereo_s::cb_left, *stereo);
+        (*stereo)->sub_right = (*pipe)->node->Subscribe(right_topic, &camgazebo_stereo_s::cb_right, *stereo);
+
+        warnx("connected to %s and %s", left_topic, right_topic);
+        *started = true;
+    }
+
     return camgazebo_ether;
 }
 
 
-/* --- Activity get_D --------------------------------------------------- */
+/* --- Activity connect_depth ------------------------------------------- */
 
-/** Codel camgz_get_D of activity get_D.
+/** Codel camgz_connect_depth of activity connect_depth.
  *
  * Triggered by camgazebo_start.
  * Yields to camgazebo_ether.
+ * Throws camgazebo_e_io.
  */
 genom_event
-camgz_get_D(const camgazebo_intrinsics *intrinsics, sequence5_float *D,
-            const genom_context self)
+camgz_connect_depth(const char topic[256], bool started,
+                    or_camera_pipe **pipe, camgazebo_depth_s **depth,
+                    const genom_context self)
 {
-    D->_length = 5;
-    D->_buffer[0] = intrinsics->data(self)->disto.k1;
-    D->_buffer[1] = intrinsics->data(self)->disto.k2;
-    D->_buffer[2] = intrinsics->data(self)->disto.k2;
-    D->_buffer[3] = intrinsics->data(self)->disto.p1;
-    D->_buffer[4] = intrinsics->data(self)->disto.p2;
+    if (!started)
+    {
+        camgazebo_e_io_detail d;
+        snprintf(d.what, sizeof(d.what), "%s", "not connected to gazebo, connect() first");
+        warnx("io error: %s", d.what);
+        return camgazebo_e_io(&d,self);
+    }
+
+    (*depth)->sub = (*pipe)->node->Subscribe(topic, &camgazebo_depth_s::cb, *depth);
+
+    warnx("connected to %s", topic);
     return camgazebo_ether;
 }
 
 
-/* --- Activity get_extrinsics ------------------------------------------ */
+/* --- Activity disconnect ---------------------------------------------- */
 
-/** Codel camgz_get_extrinsics of activity get_extrinsics.
+/** Codel camgz_disconnect of activity disconnect.
  *
  * Triggered by camgazebo_start.
  * Yields to camgazebo_ether.
  */
 genom_event
-camgz_get_extrinsics(const camgazebo_extrinsics *extrinsics,
-                     sequence6_float *ext, const genom_context self)
+camgz_disconnect(or_camera_data **data, or_camera_pipe **pipe,
+                 camgazebo_stereo_s **stereo, camgazebo_depth_s **depth,
+                 camgazebo_sensor_s **sensor, bool *started,
+                 const genom_context self)
 {
-    ext->_length = 5;
-    ext->_buffer[0] = extrinsics->data(self)->trans.tx;
-    ext->_buffer[1] = extrinsics->data(self)->trans.ty;
-    ext->_buffer[2] = extrinsics->data(self)->trans.tz;
-    ext->_buffer[3] = extrinsics->data(self)->rot.roll;
-    ext->_buffer[4] = extrinsics->data(self)->rot.pitch;
-    ext->_buffer[5] = extrinsics->data(self)->rot.yaw;
+    std::lock_guard<std::mutex> guard((*data)->m);
+
+    // the request must be out before the transport goes down
+    if ((*sensor)->enabled)
+        (*sensor)->request(false, (*sensor)->rate, true);
+    (*sensor)->detach();
+
+    if ((*pipe)->transport)
+        gazebo::client::shutdown();
+    (*pipe)->transport = false;
+    (*stereo)->reset();
+    (*depth)->sub.reset();
+    *started = false;
+
+    warnx("disconnected from gazebo");
+
     return camgazebo_ether;
 }
 
 
-/* --- Activity set_extrinsics ------------------------------------------ */
+/* --- Activity set_sim_period ------------------------------------------ */
 
-/** Codel camgz_set_extrinsics of activity set_extrinsics.
+/** Codel camgz_set_sim_period of activity set_sim_period.
  *
  * Triggered by camgazebo_start.
  * Yields to camgazebo_ether.
+ * Throws camgazebo_e_io.
  */
 genom_event
-camgz_set_extrinsics(const sequence6_float *ext_values,
-                     const camgazebo_extrinsics *extrinsics,
-                     const genom_context self)
+camgz_set_sim_period(double period_val, or_camera_data **data,
+                     camgazebo_sensor_s **sensor, const genom_context self)
 {
-    *extrinsics->data(self) = {
-        ext_values->_buffer[0],
-        ext_values->_buffer[1],
-        ext_values->_buffer[2],
-        ext_values->_buffer[3],
-        ext_values->_buffer[4],
-        ext_values->_buffer[5]
-    };
+    if (period_val < 0)
+    {
+        camgazebo_e_io_detail d;
+        snprintf(d.what, sizeof(d.what), "%s", "sim period must be positive");
+        warnx("io error: %s", d.what);
+        return camgazebo_e_io(&d,self);
+    }
 
-    extrinsics->write(self);
+    std::lock_guard<std::mutex> guard((*data)->m);
+    (*data)->sim_period = period_val;
+    (*data)->next_slot = 0;
+    (*data)->skipped = 0;
 
-    warnx("new extrinsic calibration");
+    if ((*sensor)->enabled && (*sensor)->attached())
+        (*sensor)->request((*sensor)->active, sensor_rate(**data));
+
+    if (period_val > 0)
+        warnx("set sim period to %g sec", period_val);
+    else
+        warnx("set sim period off");
     return camgazebo_ether;
 }
 
 
-/* --- Activity set_hfov ------------------------------------------------ */
+/* --- Activity get_schedule_stats -------------------------------------- */
 
-/** Codel camgz_set_hfov of activity set_hfov.
+/** Codel camgz_get_schedule_stats of activity get_schedule_stats.
  *
  * Triggered by camgazebo_start.
  * Yields to camgazebo_ether.
  */
 genom_event
-camgz_set_hfov(float hfov_val, float *hfov,
-               const or_camera_info_size_s *size,
-               const camgazebo_intrinsics *intrinsics,
-               const genom_context self)
+camgz_get_schedule_stats(or_camera_data **data, uint32_t *skipped,
+                         const genom_context self)
 {
+    std::lock_guard<std::mutex> guard((*data)->m);
+    *skipped = (*data)->skipped;
+    return camgazebo_ether;
+}
+
+
+/* --- Activity set_sensor_control ------------------------------------- */
+
+/** Codel camgz_set_sensor_control of activity set_sensor_control.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ */
+genom_event
+camgz_set_sensor_control(bool enable_val, const char control_topic[256],
+                         bool started, or_camera_data **data,
+                         camgazebo_sensor_s **sensor,
+                         const genom_context self)
+{
+    (*sensor)->enabled = enable_val;
+    (*sensor)->set_topic(control_topic);
+
+    if (enable_val && started)
+    {
+        std::lock_guard<std::mutex> guard((*data)->m);
+        if ((*sensor)->attached())
+            (*sensor)->request(true, sensor_rate(**data));
+        else
+            warnx("no sensor name in the connected topic, sensor control unavailable");
+    }
+
+    if (enable_val)
+        warnx("set sensor control on %s", control_topic);
+    else
+        warnx("set sensor control off, sensor left in its last requested state");
+    return camgazebo_ether;
+}
+
+
+/* --- Activity set_sensor_active --------------------------------------- */
+
+/** Codel camgz_set_sensor_active of activity set_sensor_active.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ * Throws camgazebo_e_io.
+ */
+genom_event
+camgz_set_sensor_active(bool active_val, or_camera_data **data,
+                        or_camera_pipe **pipe, camgazebo_sensor_s **sensor,
+                        const genom_context self)
+{
+    if (!(*sensor)->enabled || !(*sensor)->attached())
+    {
+        camgazebo_e_io_detail d;
+        snprintf(d.what, sizeof(d.what), "%s", "sensor control is off or not connected");
+        warnx("io error: %s", d.what);
+        return camgazebo_e_io(&d,self);
+    }
+
+    std::unique_lock<std::mutex> lock((*data)->m);
+    (*sensor)->request(active_val, sensor_rate(**data));
+    lock.unlock();
+
+    // a gazebo camera renders for any subscriber of its images, whatever
+    // the state the plugin sets, so frames are not taken while inactive
+    if (!active_val)
+        (*pipe)->sub.reset();
+    else if (!(*pipe)->sub)
+        (*pipe)->sub = (*pipe)->node->Subscribe((*pipe)->topic, &or_camera_data::cb, *data);
+
+    warnx("set sensor %s", active_val ? "active" : "inactive");
+    return camgazebo_ether;
+}
+
+
+/* --- Activity set_latency_budget -------------------------------------- */
+
+/** Codel camgz_set_latency_budget of activity set_latency_budget.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ */
+genom_event
+camgz_set_latency_budget(double budget_ms, camgazebo_latency_s **latency,
+                         const genom_context self)
+{
+    (*latency)->budget = budget_ms > 0 ? budget_ms * 1e-3 : 0;
+    (*latency)->frames = 0;
+    (*latency)->violations = 0;
+
+    warnx("set latency budget to %g ms", budget_ms > 0 ? budget_ms : 0);
+    return camgazebo_ether;
+}
+
+
+/* --- Activity get_latency_violations ---------------------------------- */
+
+/** Codel camgz_get_latency_violations of activity get_latency_violations.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ */
+genom_event
+camgz_get_latency_violations(camgazebo_latency_s **latency, uint32_t *frames,
+                             uint32_t *violations,
+                             sequence32_camgazebo_latency_violation *recent,
+                             const genom_context self)
+{
+    const camgazebo_latency_s* l = *latency;
+
+    *frames = l->frames;
+    *violations = l->violations;
+
+    // most recent first
+    recent->_length = std::min(l->violations, camgazebo_latency_s::ring_size);
+    for (uint32_t i = 0; i < recent->_length; i++)
+        recent->_buffer[i] = l->ring[(l->violations - 1 - i) % camgazebo_latency_s::ring_size];
+
+    return camgazebo_ether;
+}
+
+
+/* --- Activity get_stereo_stats ---------------------------------------- */
+
+/** Codel camgz_get_stereo_stats of activity get_stereo_stats.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ */
+genom_event
+camgz_get_stereo_stats(camgazebo_stereo_s **stereo, uint32_t *pairs,
+                       uint32_t *unmatched_left, uint32_t *unmatched_right,
+                       const genom_context self)
+{
+    *pairs = (*stereo)->pairs;
+    *unmatched_left = (*stereo)->unmatched_left;
+    *unmatched_right = (*stereo)->unmatched_right;
+    return camgazebo_ether;
+}
+
+
+/* --- Activity start_fanout -------------------------------------------- */
+
+/** Codel camgz_start_fanout of activity start_fanout.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ * Throws camgazebo_e_io.
+ */
+genom_event
+camgz_start_fanout(const char path[256], camgazebo_fanout_s **fanout,
+                   const genom_context self)
+{
+    if (!(*fanout)->start(path))
+    {
+        camgazebo_e_io_detail d;
+        snprintf(d.what, sizeof(d.what), "%s: %s", path, strerror(errno));
+        warnx("io error: %s", d.what);
+        return camgazebo_e_io(&d,self);
+    }
+
+    warnx("serving frames on %s", path);
+    return camgazebo_ether;
+}
+
+
+/* --- Activity stop_fanout --------------------------------------------- */
+
+/** Codel camgz_stop_fanout of activity stop_fanout.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ */
+genom_event
+camgz_stop_fanout(camgazebo_fanout_s **fanout, const genom_context self)
+{
+    (*fanout)->stop();
+
+    warnx("stopped serving frames");
+    return camgazebo_ether;
+}
+
+
+/* --- Activity get_fanout_stats ---------------------------------------- */
+
+/** Codel camgz_get_fanout_stats of activity get_fanout_stats.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ */
+genom_event
+camgz_get_fanout_stats(camgazebo_fanout_s **fanout, uint32_t *clients,
+                       uint32_t *sent, uint32_t *dropped, uint32_t *encodes,
+                       const genom_context self)
+{
+    *clients = (*fanout)->clients;
+    *sent = (*fanout)->sent;
+    *dropped = (*fanout)->dropped;
+    *encodes = (*fanout)->encodes;
+    return camgazebo_ether;
+}
+
+
+/* --- Activity export_dataset ------------------------------------------ */
+
+/** Codel camgz_export_dataset of activity export_dataset.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ * Throws camgazebo_e_io.
+ */
+genom_event
+camgz_export_dataset(const char dir[256], camgazebo_exporter_s **exporter,
+                     const genom_context self)
+{
+    if (!(*exporter)->start(dir))
+    {
+        camgazebo_e_io_detail d;
+        snprintf(d.what, sizeof(d.what), "cannot create %s: %s", dir, strerror(errno));
+        warnx("io error: %s", d.what);
+        return camgazebo_e_io(&d,self);
+    }
+
+    warnx("exporting dataset to %s%s", dir, (*exporter)->uring ? " (io_uring)" : "");
+    return camgazebo_ether;
+}
+
+
+/* --- Activity stop_export --------------------------------------------- */
+
+/** Codel camgz_stop_export of activity stop_export.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ */
+genom_event
+camgz_stop_export(camgazebo_exporter_s **exporter, const genom_context self)
+{
+    (*exporter)->stop();
+
+    warnx("stopped dataset export, %llu files", (unsigned long long)(*exporter)->files);
+    return camgazebo_ether;
+}
+
+
+/* --- Activity get_export_stats ---------------------------------------- */
+
+/** Codel camgz_get_export_stats of activity get_export_stats.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ */
+genom_event
+camgz_get_export_stats(camgazebo_exporter_s **exporter, uint32_t *files,
+                       uint32_t *dropped, uint32_t *errors,
+                       double *files_per_sec, double *mb_per_sec,
+                       const genom_context self)
+{
+    double t = (*exporter)->elapsed();
+
+    *files = (*exporter)->files;
+    *dropped = (*exporter)->dropped;
+    *errors = (*exporter)->errors;
+    *files_per_sec = t > 0 ? (*exporter)->files / t : 0;
+    *mb_per_sec = t > 0 ? (*exporter)->bytes / t / 1e6 : 0;
+    return camgazebo_ether;
+}
+
+
+/* --- Activity start_log ----------------------------------------------- */
+
+/** Codel camgz_start_log of activity start_log.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ * Throws camgazebo_e_io.
+ */
+genom_event
+camgz_start_log(const char path[256],
+                camgazebo_log_compression compression, bool raw_val,
+                bool compressed_val, camgazebo_logger_s **logger,
+                const genom_context self)
+{
+    mcap_writer::compression c =
+        compression == camgazebo_log_zstd ? mcap_writer::zstd :
+        compression == camgazebo_log_lz4 ? mcap_writer::lz4 : mcap_writer::none;
+
+    camgazebo_e_io_detail d;
+    if (!mcap_writer::supports(c))
+        snprintf(d.what, sizeof(d.what), "%s", "compression not available in this build");
+    else if (!(*logger)->start(path, c))
+        snprintf(d.what, sizeof(d.what), "cannot open %s: %s", path, strerror(errno));
+    else
+    {
+        (*logger)->raw = raw_val;
+        (*logger)->compressed = compressed_val;
+
+        warnx("logging to %s", path);
+        return camgazebo_ether;
+    }
+
+    warnx("io error: %s", d.what);
+    return camgazebo_e_io(&d,self);
+}
+
+
+/* --- Activity stop_log ------------------------------------------------ */
+
+/** Codel camgz_stop_log of activity stop_log.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ */
+genom_event
+camgz_stop_log(camgazebo_logger_s **logger, const genom_context self)
+{
+    (*logger)->stop();
+
+    warnx("stopped log, %u messages", (unsigned)(*logger)->messages);
+    return camgazebo_ether;
+}
+
+
+/* --- Activity get_log_stats ------------------------------------------- */
+
+/** Codel camgz_get_log_stats of activity get_log_stats.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ */
+genom_event
+camgz_get_log_stats(camgazebo_logger_s **logger, uint32_t *messages,
+                    uint32_t *dropped, double *mb,
+                    const genom_context self)
+{
+    *messages = (*logger)->messages;
+    *dropped = (*logger)->dropped;
+    *mb = (*logger)->bytes / 1e6;
+    return camgazebo_ether;
+}
+
+
+/* --- Activity get_K --------------------------------------------------- */
+
+/** Codel camgz_get_K of activity get_K.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ */
+genom_event
+camgz_get_K(const camgazebo_intrinsics *intrinsics, sequence5_float *K,
+            const genom_context self)
+{
+    K->_length = 5;
+    K->_buffer[0] = intrinsics->data(self)->calib.fx;
+    K->_buffer[1] = intrinsics->data(self)->calib.fy;
+    K->_buffer[2] = intrinsics->data(self)->calib.cx;
+    K->_buffer[3] = intrinsics->data(self)->calib.cy;
+    K->_buffer[4] = intrinsics->data(self)->calib.gamma;
+    return camgazebo_ether;
+}
+
+
+/* --- Activity get_D --------------------------------------------------- */
+
+/** Codel camgz_get_D of activity get_D.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ */
+genom_event
+camgz_get_D(const camgazebo_intrinsics *intrinsics, sequence5_float *D,
+            const genom_context self)
+{
+    D->_length = 5;
+    D->_buffer[0] = intrinsics->data(self)->disto.k1;
+    D->_buffer[1] = intrinsics->data(self)->disto.k2;
+    D->_buffer[2] = intrinsics->data(self)->disto.k2;
+    D->_buffer[3] = intrinsics->data(self)->disto.p1;
+    D->_buffer[4] = intrinsics->data(self)->disto.p2;
+    return camgazebo_ether;
+}
+
+
+/* --- Activity get_extrinsics ------------------------------------------ */
+
+/** Codel camgz_get_extrinsics of activity get_extrinsics.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ */
+genom_event
+camgz_get_extrinsics(const camgazebo_extrinsics *extrinsics,
+                     sequence6_float *ext, const genom_context self)
+{
+    ext->_length = 5;
+    ext->_buffer[0] = extrinsics->data(self)->trans.tx;
+    ext->_buffer[1] = extrinsics->data(self)->trans.ty;
+    ext->_buffer[2] = extrinsics->data(self)->trans.tz;
+    ext->_buffer[3] = extrinsics->data(self)->rot.roll;
+    ext->_buffer[4] = extrinsics->data(self)->rot.pitch;
+    ext->_buffer[5] = extrinsics->data(self)->rot.yaw;
+    return camgazebo_ether;
+}
+
+
+/* --- Activity set_extrinsics ------------------------------------------ */
+
+/** Codel camgz_set_extrinsics of activity set_extrinsics.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ */
+genom_event
+camgz_set_extrinsics(const sequence6_float *ext_values,
+                     camgazebo_stereo_s **stereo,
+                     const camgazebo_extrinsics *extrinsics,
+                     const genom_context self)
+{
+    *extrinsics->data(self) = {
+        ext_values->_buffer[0],
+        ext_values->_buffer[1],
+        ext_values->_buffer[2],
+        ext_values->_buffer[3],
+        ext_values->_buffer[4],
+        ext_values->_buffer[5]
+    };
+
+    extrinsics->write(self);
+    (*stereo)->maps_dirty = true;
+
+    warnx("new extrinsic calibration");
+    return camgazebo_ether;
+}
+
+
+/* --- Activity set_hfov ------------------------------------------------ */
+
+/** Codel camgz_set_hfov of activity set_hfov.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ * Throws camgazebo_e_io.
+ */
+genom_event
+camgz_set_hfov(float hfov_val, float *hfov,
+               const or_camera_info_size_s *size,
+               camgazebo_projection proj_out, const float proj_kb[4],
+               camgazebo_stereo_s **stereo, camgazebo_depth_s **depth,
+               camgazebo_reproj_s **reproj,
+               const camgazebo_intrinsics *intrinsics,
+               const genom_context self)
+{
+    if (proj_out == camgazebo_proj_pinhole && hfov_val >= M_PI)
+    {
+        camgazebo_e_io_detail d;
+        snprintf(d.what, sizeof(d.what), "%s", "pinhole output cannot cover the field of view");
+        warnx("io error: %s", d.what);
+        return camgazebo_e_io(&d,self);
+    }
+
     *hfov = hfov_val;
 
-    compute_calib(intrinsics->data(self), *hfov, *size);
+    compute_calib(intrinsics->data(self), *hfov, *size, proj_out, proj_kb);
+    intrinsics->write(self);
+    (*stereo)->maps_dirty = true;
+    (*depth)->rays_dirty = true;
+    (*reproj)->dirty = true;
+
+    warnx("set horizontal fov");
+    return camgazebo_ether;
+}
+
+
+/* --- Activity set_format ---------------------------------------------- */
+
+// gazebo name of the c channels of d bytes format
+static const char* gazebo_format(uint16_t c, uint16_t d)
+{
+    return c == 1 ? (d == 1 ? "L8" : "L16") : (d == 1 ? "R8G8B8" : "R16G16B16");
+}
+
+// frames rendered at w x h pixels of c channels of d bytes, published at
+// ow x oh; sizes the buffers and the ports and updates the calibration
+static genom_event
+set_frame_format(uint16_t w, uint16_t h, uint16_t c, uint16_t d,
+                 uint16_t ow, uint16_t oh, or_camera_data* data,
+                 camgazebo_stereo_s* stereo, camgazebo_frames_s* frames,
+                 float hfov, camgazebo_projection proj_out,
+                 const float proj_kb[4], float exposure, float line_readout,
+                 or_camera_info_size_s *size, char format[8],
+                 const camgazebo_frame *frame,
+                 const camgazebo_intrinsics *intrinsics,
+                 const camgazebo_timing *timing, const genom_context self)
+{
+    std::unique_lock<std::mutex> lock(data->m);
+    if (!data->set_size(w, h, c, d)) {
+        camgazebo_e_mem_detail e;
+        snprintf(e.what, sizeof(e.what), "unable to allocate frame memory");
+        warnx("%s", e.what);
+        return camgazebo_e_mem(&e,self);
+    }
+    lock.unlock();
+    stereo->l = data->l;
+    stereo->maps_dirty = true;
+
+    // format branches are resolved here, once, for the buffer just sized
+    frames->pipeline.reset(make_pixel_pipeline(c, d));
+
+    *size = {ow, oh};
+    if (c == 1)
+        snprintf(format, sizeof(char)*8, d == 1 ? "Y8" : "Y16");
+    if (c == 3)
+        snprintf(format, sizeof(char)*8, d == 1 ? "RBG8" : "RGB16");
+
+    frames->resampler.configure(w, h, ow, oh, c * d);
+
+    if (size_frame_ports(frame, ow, oh, c * d, data->mem, self) == -1) {
+        camgazebo_e_mem_detail e;
+        snprintf(e.what, sizeof(e.what), "unable to allocate frame memory");
+        warnx("%s", e.what);
+        return camgazebo_e_mem(&e,self);
+    }
+
+    compute_calib(intrinsics->data(self), hfov, *size, proj_out, proj_kb);
+    intrinsics->write(self);
+
+    if (update_timing(timing->data(self), oh, exposure, line_readout) == -1) {
+        camgazebo_e_mem_detail e;
+        snprintf(e.what, sizeof(e.what), "unable to allocate timing memory");
+        warnx("%s", e.what);
+        return camgazebo_e_mem(&e,self);
+    }
+    return genom_ok;
+}
+
+/** Codel camgz_set_fmt of activity set_format.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether, camgazebo_confirm.
+ * Throws camgazebo_e_io, camgazebo_e_mem.
+ */
+genom_event
+camgz_set_fmt(uint16_t w_val, uint16_t h_val, uint16_t c_val,
+              uint16_t d_val, bool push_val, double timeout_val,
+              or_camera_data **data, camgazebo_stereo_s **stereo,
+              camgazebo_frames_s **frames, camgazebo_sensor_s **sensor,
+              float hfov,
+              camgazebo_projection proj_out, const float proj_kb[4],
+              float exposure, float line_readout,
+              or_camera_info_size_s *size, char format[8],
+              const camgazebo_frame *frame,
+              const camgazebo_intrinsics *intrinsics,
+              const camgazebo_timing *timing, const genom_context self)
+{
+    if ((c_val != 1 && c_val != 3) || (d_val != 8 && d_val != 16))
+    {
+        camgazebo_e_io_detail d;
+        snprintf(d.what, sizeof(d.what), "%s", "unsupported format, expecting 1 or 3 channels of 8 or 16 bits");
+        warnx("io error: %s", d.what);
+        return camgazebo_e_io(&d,self);
+    }
+    if (push_val && (!(*sensor)->enabled || !(*sensor)->attached()))
+    {
+        camgazebo_e_io_detail d;
+        snprintf(d.what, sizeof(d.what), "%s", "sensor control is off or not connected, cannot push the format");
+        warnx("io error: %s", d.what);
+        return camgazebo_e_io(&d,self);
+    }
+
+    // kept to go back to if the gazebo camera does not follow
+    camgazebo_sensor_s::format_s& prev = (*sensor)->previous;
+    prev = { (*data)->w, (*data)->h, (*data)->c, (*data)->d, size->w, size->h,
+             (*sensor)->width, (*sensor)->height, (*sensor)->format };
+
+    // frames are published at the rendered size until set_output_size
+    genom_event e = set_frame_format(w_val, h_val, c_val, d_val / 8, w_val, h_val,
+                                     *data, *stereo, *frames, hfov, proj_out, proj_kb,
+                                     exposure, line_readout, size, format,
+                                     frame, intrinsics, timing, self);
+    if (e != genom_ok)
+        return e;
+
+    if (push_val)
+    {
+        std::unique_lock<std::mutex> lock((*data)->m);
+        (*sensor)->pending_after = (*data)->received;
+        lock.unlock();
+        (*sensor)->request_image(w_val, h_val, gazebo_format(c_val, d_val / 8));
+        (*sensor)->pending_deadline = std::chrono::steady_clock::now() +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(timeout_val));
+        warnx("set image format, waiting for the gazebo camera");
+        return camgazebo_confirm;
+    }
+
+    warnx("set image format");
+    return camgazebo_ether;
+}
+
+
+/** Codel camgz_confirm_fmt of activity set_format.
+ *
+ * Triggered by camgazebo_confirm.
+ * Yields to camgazebo_pause_confirm, camgazebo_ether.
+ * Throws camgazebo_e_io, camgazebo_e_mem.
+ */
+genom_event
+camgz_confirm_fmt(or_camera_data **data, camgazebo_stereo_s **stereo,
+                  camgazebo_frames_s **frames,
+                  camgazebo_sensor_s **sensor, float hfov,
+                  camgazebo_projection proj_out,
+                  const float proj_kb[4], float exposure,
+                  float line_readout, or_camera_info_size_s *size,
+                  char format[8], const camgazebo_frame *frame,
+                  const camgazebo_intrinsics *intrinsics,
+                  const camgazebo_timing *timing,
+                  const genom_context self)
+{
+    // frames of another size are rejected by cb, so any new one matches
+    std::unique_lock<std::mutex> lock((*data)->m);
+    bool confirmed = (*data)->received > (*sensor)->pending_after;
+    lock.unlock();
+
+    if (confirmed)
+    {
+        warnx("gazebo camera renders at %ux%u %s",
+              (*sensor)->width, (*sensor)->height, (*sensor)->format.c_str());
+        return camgazebo_ether;
+    }
+
+    if (std::chrono::steady_clock::now() <= (*sensor)->pending_deadline)
+        return camgazebo_pause_confirm;
+
+    // back to the format frames were received at, and ask the camera for it
+    const camgazebo_sensor_s::format_s& prev = (*sensor)->previous;
+    genom_event e = set_frame_format(prev.w, prev.h, prev.c, prev.d, prev.ow, prev.oh,
+                                     *data, *stereo, *frames, hfov, proj_out, proj_kb,
+                                     exposure, line_readout, size, format,
+                                     frame, intrinsics, timing, self);
+    if (e != genom_ok)
+        return e;
+
+    // a camera left at its sdf settings is asked for the previous frames
+    if (prev.width && prev.height)
+        (*sensor)->request_image(prev.width, prev.height, prev.format.c_str());
+    else
+        (*sensor)->request_image(prev.w, prev.h, gazebo_format(prev.c, prev.d));
+
+    camgazebo_e_io_detail d;
+    snprintf(d.what, sizeof(d.what), "%s", "no frame from the gazebo camera at the new format");
+    warnx("io error: %s", d.what);
+    return camgazebo_e_io(&d,self);
+}
+
+
+/* --- Activity set_output_size ---------------------------------------- */
+
+/** Codel camgz_set_output_size of activity set_output_size.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ * Throws camgazebo_e_io, camgazebo_e_mem.
+ */
+genom_event
+camgz_set_output_size(uint16_t w_val, uint16_t h_val, or_camera_data **data,
+                      camgazebo_stereo_s **stereo,
+                      camgazebo_frames_s **frames, float hfov,
+                      camgazebo_projection proj_out,
+                      const float proj_kb[4], float exposure,
+                      float line_readout, or_camera_info_size_s *size,
+                      const camgazebo_frame *frame,
+                      const camgazebo_intrinsics *intrinsics,
+                      const camgazebo_timing *timing,
+                      const genom_context self)
+{
+    // the rendered format only changes in set_format, from this task
+    uint16_t rw = (*data)->w, rh = (*data)->h, bpp = (*data)->c * (*data)->d;
+
+    if (!w_val && !h_val)
+    {
+        w_val = rw;
+        h_val = rh;
+    }
+    if (!w_val || !h_val || w_val > rw || h_val > rh)
+    {
+        camgazebo_e_io_detail d;
+        snprintf(d.what, sizeof(d.what), "%s", "expecting an output size within the rendered one");
+        warnx("io error: %s", d.what);
+        return camgazebo_e_io(&d,self);
+    }
+    // pixels stay square, so that fx = fy holds for the published frames;
+    // either side may be rounded
+    if (std::abs((int64_t)w_val * rh - (int64_t)h_val * rw) * 2 > std::max(rw, rh))
+    {
+        camgazebo_e_io_detail d;
+        snprintf(d.what, sizeof(d.what), "%s", "expecting an output size of the rendered aspect ratio");
+        warnx("io error: %s", d.what);
+        return camgazebo_e_io(&d,self);
+    }
+    if ((*stereo)->enabled)
+    {
+        camgazebo_e_io_detail d;
+        snprintf(d.what, sizeof(d.what), "%s", "stereo pairs are published at the rendered size");
+        warnx("io error: %s", d.what);
+        return camgazebo_e_io(&d,self);
+    }
+
+    (*frames)->resampler.configure(rw, rh, w_val, h_val, bpp);
+    *size = {w_val, h_val};
+    (*stereo)->maps_dirty = true;
+
+    if (size_frame_ports(frame, w_val, h_val, bpp, (*data)->mem, self) == -1) {
+        camgazebo_e_mem_detail d;
+        snprintf(d.what, sizeof(d.what), "unable to allocate frame memory");
+        warnx("%s", d.what);
+        return camgazebo_e_mem(&d,self);
+    }
+
+    // same field of view over fewer pixels
+    compute_calib(intrinsics->data(self), hfov, *size, proj_out, proj_kb);
     intrinsics->write(self);
 
-    warnx("set horizontal fov");
+    if (update_timing(timing->data(self), h_val, exposure, line_readout) == -1) {
+        camgazebo_e_mem_detail d;
+        snprintf(d.what, sizeof(d.what), "unable to allocate timing memory");
+        warnx("%s", d.what);
+        return camgazebo_e_mem(&d,self);
+    }
+
+    warnx("set output size to %ux%u", w_val, h_val);
     return camgazebo_ether;
 }
 
 
-/* --- Activity set_format ---------------------------------------------- */
+/* --- Activity set_alloc_policy ---------------------------------------- */
 
-/** Codel camgz_set_fmt of activity set_format.
+/** Codel camgz_set_alloc_policy of activity set_alloc_policy.
  *
  * Triggered by camgazebo_start.
  * Yields to camgazebo_ether.
- * Throws camgazebo_e_io.
+ * Throws camgazebo_e_mem.
  */
 genom_event
-camgz_set_fmt(uint16_t w_val, uint16_t h_val, uint16_t c_val,
-              or_camera_data **data, float hfov,
-              or_camera_info_size_s *size, char format[8],
-              const camgazebo_frame *frame,
-              const camgazebo_intrinsics *intrinsics,
-              const genom_context self)
+camgz_set_alloc_policy(camgazebo_page_policy pages_val, int16_t node_val,
+                       or_camera_data **data, camgazebo_frames_s **frames,
+                       const camgazebo_frame *frame,
+                       const genom_context self)
 {
-    *size = {w_val, h_val};
-    if (c_val == 1)
-        snprintf(format, sizeof(char)*8, "Y8");
-    if (c_val == 3)
-        snprintf(format, sizeof(char)*8, "RBG8");
-
-    (*data)->set_size(w_val, h_val, c_val);
+    std::unique_lock<std::mutex> lock((*data)->m);
 
-    if (genom_sequence_reserve(&(frame->data("raw", self)->pixels), (*data)->l) == -1) {
+    // reallocated from the main task, which reads the frames
+    (*data)->mem.pages = pages_val;
+    (*data)->mem.node = node_val;
+    if (!(*data)->set_size((*data)->w, (*data)->h, (*data)->c, (*data)->d)) {
         camgazebo_e_mem_detail d;
         snprintf(d.what, sizeof(d.what), "unable to allocate frame memory");
         warnx("%s", d.what);
         return camgazebo_e_mem(&d,self);
     }
-    frame->data("raw", self)->pixels._length = (*data)->l;
-    frame->data("raw", self)->height = h_val;
-    frame->data("raw", self)->width = w_val;
-    frame->data("raw", self)->bpp = c_val;
+    // the new mapping is zero filled, a pending frame is lost
+    (*data)->new_frame = false;
+    lock.unlock();
 
-    (void)genom_sequence_reserve(&(frame->data("compressed", self)->pixels), 0);
-    frame->data("compressed", self)->pixels._length = 0;
-    frame->data("compressed", self)->height = h_val;
-    frame->data("compressed", self)->width = w_val;
-    frame->data("compressed", self)->bpp = c_val;
+    or_sensor_frame* rfdata = frame->data("raw", self);
+    frame_advise(rfdata->pixels._buffer, rfdata->pixels._maximum, pages_val, node_val);
 
-    compute_calib(intrinsics->data(self), hfov, *size);
-    intrinsics->write(self);
+    // bandwidth is measured from scratch with the new policy
+    (*frames)->copies = 0;
+    (*frames)->copy_bytes = 0;
+    (*frames)->copy_sec = 0;
 
-    warnx("set image format");
+    warnx("set allocation policy%s", (*data)->mem.huge ? " (explicit huge pages)" : "");
+    return camgazebo_ether;
+}
+
+
+/* --- Activity get_copy_stats ------------------------------------------ */
+
+/** Codel camgz_get_copy_stats of activity get_copy_stats.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ */
+genom_event
+camgz_get_copy_stats(or_camera_data **data, camgazebo_frames_s **frames,
+                     uint32_t *copies, double *mb_per_sec, bool *huge_pages,
+                     const genom_context self)
+{
+    *copies = (*frames)->copies;
+    *mb_per_sec = (*frames)->copy_sec > 0 ? (*frames)->copy_bytes / (*frames)->copy_sec / 1e6 : 0;
+    *huge_pages = (*data)->mem.huge;
+    return camgazebo_ether;
+}
+
+
+/* --- Activity get_dispatch -------------------------------------------- */
+
+/** Codel camgz_get_dispatch of activity get_dispatch.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ */
+genom_event
+camgz_get_dispatch(camgazebo_isa *detected, camgazebo_isa *selected,
+                   const genom_context self)
+{
+    *detected = isa_detect();
+    *selected = kernels.isa;
+    return camgazebo_ether;
+}
+
+
+/* --- Activity set_dispatch -------------------------------------------- */
+
+/** Codel camgz_set_dispatch of activity set_dispatch.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ * Throws camgazebo_e_io.
+ */
+genom_event
+camgz_set_dispatch(camgazebo_isa isa_val, or_camera_data **data,
+                   const genom_context self)
+{
+    // the transport callback copies frames with the lock held, other
+    // kernels run in the main task
+    std::lock_guard<std::mutex> guard((*data)->m);
+
+    if (!isa_select(isa_val))
+    {
+        camgazebo_e_io_detail d;
+        snprintf(d.what, sizeof(d.what), "%s kernels not supported by this cpu", isa_name(isa_val));
+        warnx("io error: %s", d.what);
+        return camgazebo_e_io(&d,self);
+    }
+
+    warnx("set %s image kernels", isa_name(kernels.isa));
+    return camgazebo_ether;
+}
+
+
+/* --- Activity set_exposure -------------------------------------------- */
+
+/** Codel camgz_set_exposure of activity set_exposure.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ * Throws camgazebo_e_io, camgazebo_e_mem.
+ */
+genom_event
+camgz_set_exposure(float exposure_val, float readout_val,
+                   const or_camera_info_size_s *size, float *exposure,
+                   float *line_readout, const camgazebo_timing *timing,
+                   const genom_context self)
+{
+    if (exposure_val < 0 || readout_val < 0)
+    {
+        camgazebo_e_io_detail d;
+        snprintf(d.what, sizeof(d.what), "%s", "exposure and readout times must be positive");
+        warnx("io error: %s", d.what);
+        return camgazebo_e_io(&d,self);
+    }
+
+    if (update_timing(timing->data(self), size->h, exposure_val, readout_val) == -1) {
+        camgazebo_e_mem_detail d;
+        snprintf(d.what, sizeof(d.what), "unable to allocate timing memory");
+        warnx("%s", d.what);
+        return camgazebo_e_mem(&d,self);
+    }
+    *exposure = exposure_val;
+    *line_readout = readout_val;
+
+    warnx("set exposure %g sec, line readout %g sec", exposure_val, readout_val);
     return camgazebo_ether;
 }
 
@@ -418,6 +1866,7 @@ camgz_set_fmt(uint16_t w_val, uint16_t h_val, uint16_t c_val,
  */
 genom_event
 camgz_set_disto(const sequence5_float *dist_values,
+                camgazebo_stereo_s **stereo, camgazebo_depth_s **depth,
                 const camgazebo_intrinsics *intrinsics,
                 const genom_context self)
 {
@@ -430,7 +1879,359 @@ camgz_set_disto(const sequence5_float *dist_values,
     };
 
     intrinsics->write(self);
+    (*stereo)->maps_dirty = true;
+    (*depth)->rays_dirty = true;
 
     warnx("set distortion coefficients");
     return camgazebo_ether;
 }
+
+
+/* --- Activity set_projection ------------------------------------------ */
+
+/** Codel camgz_set_projection of activity set_projection.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ * Throws camgazebo_e_io.
+ */
+genom_event
+camgz_set_projection(camgazebo_projection lens_val,
+                     camgazebo_projection output_val,
+                     const sequence4_float *kb_val, float hfov,
+                     const or_camera_info_size_s *size,
+                     camgazebo_projection *proj_lens,
+                     camgazebo_projection *proj_out, float proj_kb[4],
+                     camgazebo_stereo_s **stereo, camgazebo_depth_s **depth,
+                     camgazebo_reproj_s **reproj,
+                     const camgazebo_intrinsics *intrinsics,
+                     const camgazebo_lens *lens, const genom_context self)
+{
+    if (output_val == camgazebo_proj_pinhole && hfov >= M_PI)
+    {
+        camgazebo_e_io_detail d;
+        snprintf(d.what, sizeof(d.what), "%s", "pinhole output cannot cover the field of view");
+        warnx("io error: %s", d.what);
+        return camgazebo_e_io(&d,self);
+    }
+
+    // Brown-Conrady coefficients set for another model do not apply
+    if (output_val != *proj_out)
+    {
+        intrinsics->data(self)->disto = {0,0,0,0,0};
+        (*stereo)->maps_dirty = true;
+        (*depth)->rays_dirty = true;
+    }
+
+    *proj_lens = lens_val;
+    *proj_out = output_val;
+    for (uint32_t i = 0; i < 4; i++)
+        proj_kb[i] = i < kb_val->_length ? kb_val->_buffer[i] : 0;
+    (*reproj)->dirty = true;
+
+    compute_calib(intrinsics->data(self), hfov, *size, *proj_out, proj_kb);
+    intrinsics->write(self);
+
+    camgazebo_lens_model* ldata = lens->data(self);
+    ldata->model = *proj_out;
+    for (int i = 0; i < 4; i++)
+        ldata->kb[i] = *proj_out == camgazebo_proj_kannala_brandt ? proj_kb[i] : 0;
+    lens->write(self);
+
+    warnx("set projection model");
+    return camgazebo_ether;
+}
+
+
+/* --- Activity set_motion_trigger -------------------------------------- */
+
+/** Codel camgz_set_motion_trigger of activity set_motion_trigger.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ * Throws camgazebo_e_io.
+ */
+genom_event
+camgz_set_motion_trigger(bool enable_val, float threshold_val,
+                         double keepalive_val, camgazebo_motion_s **motion,
+                         const genom_context self)
+{
+    if (threshold_val < 0 || keepalive_val < 0)
+    {
+        camgazebo_e_io_detail d;
+        snprintf(d.what, sizeof(d.what), "%s", "threshold and keep-alive must be positive");
+        warnx("io error: %s", d.what);
+        return camgazebo_e_io(&d,self);
+    }
+
+    (*motion)->enabled = enable_val;
+    (*motion)->threshold = threshold_val;
+    (*motion)->keepalive = keepalive_val;
+    (*motion)->published = 0;
+    (*motion)->skipped = 0;
+    (*motion)->reset();
+
+    warnx("set motion trigger %s", enable_val ? "on" : "off");
+    return camgazebo_ether;
+}
+
+
+/* --- Activity get_motion_stats ---------------------------------------- */
+
+/** Codel camgz_get_motion_stats of activity get_motion_stats.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ */
+genom_event
+camgz_get_motion_stats(camgazebo_motion_s **motion, uint32_t *published,
+                       uint32_t *skipped, const genom_context self)
+{
+    *published = (*motion)->published;
+    *skipped = (*motion)->skipped;
+    return camgazebo_ether;
+}
+
+
+/* --- Activity set_tiles ---------------------------------------------- */
+
+/** Codel camgz_set_tiles of activity set_tiles.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ * Throws camgazebo_e_io.
+ */
+genom_event
+camgz_set_tiles(bool enable_val, uint16_t tile_size_val,
+                uint16_t keyframe_val, int16_t quality_val,
+                camgazebo_tiler_s **tiler, const genom_context self)
+{
+    if (tile_size_val < 8 || quality_val < 0 || quality_val > 100)
+    {
+        camgazebo_e_io_detail d;
+        snprintf(d.what, sizeof(d.what), "%s", "expecting tiles of at least 8 pixels and a quality in 0-100");
+        warnx("io error: %s", d.what);
+        return camgazebo_e_io(&d,self);
+    }
+
+    (*tiler)->enabled = enable_val;
+    (*tiler)->size = tile_size_val;
+    (*tiler)->keyframe_interval = keyframe_val;
+    (*tiler)->quality = quality_val;
+    (*tiler)->updates = 0;
+    (*tiler)->keyframes = 0;
+    (*tiler)->tiles = 0;
+    (*tiler)->reset();
+
+    warnx("set tiles %s", enable_val ? "on" : "off");
+    return camgazebo_ether;
+}
+
+
+/* --- Activity get_tile_stats ------------------------------------------ */
+
+/** Codel camgz_get_tile_stats of activity get_tile_stats.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ */
+genom_event
+camgz_get_tile_stats(camgazebo_tiler_s **tiler, uint32_t *updates,
+                     uint32_t *keyframes, uint32_t *tiles,
+                     const genom_context self)
+{
+    *updates = (*tiler)->updates;
+    *keyframes = (*tiler)->keyframes;
+    *tiles = (*tiler)->tiles;
+    return camgazebo_ether;
+}
+
+
+/* --- Activity set_tensor -------------------------------------------- */
+
+/** Codel camgz_set_tensor of activity set_tensor.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ * Throws camgazebo_e_io.
+ */
+genom_event
+camgz_set_tensor(bool enable_val, uint16_t w_val, uint16_t h_val,
+                 bool letterbox_val, float pad_val,
+                 const sequence3_float *mean_val,
+                 const sequence3_float *std_val,
+                 camgazebo_tensor_type type_val, float quant_scale_val,
+                 int16_t quant_zero_val,
+                 camgazebo_tensorizer_s **tensorizer,
+                 const genom_context self)
+{
+    bool std_ok = true;
+    for (uint32_t i = 0; i < std_val->_length; i++)
+        std_ok = std_ok && std_val->_buffer[i] != 0;
+
+    if (!w_val || !h_val || !std_ok || quant_scale_val <= 0)
+    {
+        camgazebo_e_io_detail d;
+        snprintf(d.what, sizeof(d.what), "%s", "expecting a tensor size, non zero std and a positive quantization step");
+        warnx("io error: %s", d.what);
+        return camgazebo_e_io(&d,self);
+    }
+
+    camgazebo_tensorizer_s* t = *tensorizer;
+    t->enabled = enable_val;
+    t->w = w_val;
+    t->h = h_val;
+    t->letterbox = letterbox_val;
+    t->pad = pad_val;
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        t->mean[i] = i < mean_val->_length ? mean_val->_buffer[i] : 0;
+        t->std[i] = i < std_val->_length ? std_val->_buffer[i] : 255;
+    }
+    t->type = type_val;
+    t->quant_scale = quant_scale_val;
+    t->quant_zero = quant_zero_val;
+    t->invalidate();
+
+    warnx("set tensor %s", enable_val ? "on" : "off");
+    return camgazebo_ether;
+}
+
+
+/* --- Activity set_fiducials ----------------------------------------- */
+
+/** Codel camgz_set_fiducials of activity set_fiducials.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ * Throws camgazebo_e_io.
+ */
+genom_event
+camgz_set_fiducials(bool enable_val, camgazebo_tag_family family_val,
+                    float tag_size_val, bool exclusive_val,
+                    camgazebo_fiducial_s **fiducial,
+                    const genom_context self)
+{
+    if (enable_val && !camgazebo_fiducial_s::available())
+    {
+        camgazebo_e_io_detail d;
+        snprintf(d.what, sizeof(d.what), "%s", "built without the opencv aruco module");
+        warnx("io error: %s", d.what);
+        return camgazebo_e_io(&d,self);
+    }
+    if (tag_size_val <= 0)
+    {
+        camgazebo_e_io_detail d;
+        snprintf(d.what, sizeof(d.what), "%s", "marker size must be positive");
+        warnx("io error: %s", d.what);
+        return camgazebo_e_io(&d,self);
+    }
+
+    // a detection in flight completes with the previous settings
+    (*fiducial)->enabled = enable_val;
+    (*fiducial)->family = family_val;
+    (*fiducial)->tag_size = tag_size_val;
+    (*fiducial)->exclusive = exclusive_val;
+    (*fiducial)->frames = 0;
+    (*fiducial)->detections = 0;
+    (*fiducial)->skipped = 0;
+
+    warnx("set fiducials %s", enable_val ? "on" : "off");
+    return camgazebo_ether;
+}
+
+
+/* --- Activity get_fiducial_stats -------------------------------------- */
+
+/** Codel camgz_get_fiducial_stats of activity get_fiducial_stats.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ */
+genom_event
+camgz_get_fiducial_stats(camgazebo_fiducial_s **fiducial, uint32_t *frames,
+                         uint32_t *detections, uint32_t *skipped,
+                         const genom_context self)
+{
+    *frames = (*fiducial)->frames;
+    *detections = (*fiducial)->detections;
+    *skipped = (*fiducial)->skipped;
+    return camgazebo_ether;
+}
+
+
+/* --- Activity set_right_extrinsics ------------------------------------ */
+
+/** Codel camgz_set_right_extrinsics of activity set_right_extrinsics.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ */
+genom_event
+camgz_set_right_extrinsics(const sequence6_float *ext_values,
+                           camgazebo_stereo_s **stereo,
+                           const genom_context self)
+{
+    for (int i = 0; i < 6; i++)
+        (*stereo)->right_ext[i] = ext_values->_buffer[i];
+    (*stereo)->maps_dirty = true;
+
+    warnx("new right camera extrinsic calibration");
+    return camgazebo_ether;
+}
+
+
+/* --- Activity set_stereo_processing ----------------------------------- */
+
+/** Codel camgz_set_stereo_processing of activity set_stereo_processing.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ * Throws camgazebo_e_io.
+ */
+genom_event
+camgz_set_stereo_processing(bool rectify_val, bool disparity_val,
+                            uint16_t num_disparities_val,
+                            uint16_t block_size_val,
+                            camgazebo_stereo_s **stereo,
+                            const genom_context self)
+{
+    if (disparity_val && (num_disparities_val == 0 || num_disparities_val % 16
+                          || block_size_val < 5 || block_size_val % 2 == 0))
+    {
+        camgazebo_e_io_detail d;
+        snprintf(d.what, sizeof(d.what), "%s", "disparities must be a multiple of 16 and block size odd >= 5");
+        warnx("io error: %s", d.what);
+        return camgazebo_e_io(&d,self);
+    }
+
+    (*stereo)->rectify = rectify_val || disparity_val;
+    (*stereo)->disparity = disparity_val;
+    (*stereo)->num_disparities = num_disparities_val;
+    (*stereo)->block_size = block_size_val;
+
+    warnx("set stereo processing");
+    return camgazebo_ether;
+}
+
+
+/* --- Activity set_cloud ----------------------------------------------- */
+
+/** Codel camgz_set_cloud of activity set_cloud.
+ *
+ * Triggered by camgazebo_start.
+ * Yields to camgazebo_ether.
+ */
+genom_event
+camgz_set_cloud(bool enable_val, bool rgb_val, float voxel_val,
+                float range_val, camgazebo_depth_s **depth,
+                const genom_context self)
+{
+    (*depth)->enabled = enable_val;
+    (*depth)->rgb = rgb_val;
+    (*depth)->voxel = voxel_val;
+    (*depth)->max_range = range_val;
+
+    warnx("set point cloud output");
+    return camgazebo_ether;
+}
@@ -30,42 +30,120 @@
 
 #include <gazebo/transport/transport.hh>
 #include <gazebo/gazebo_client.hh>
+#include <opencv2/opencv.hpp>
 
 #include <err.h>
+#include <cmath>
 #include <condition_variable>
 #include <mutex>
 #include <sys/time.h>
+#include <vector>
+
+#include "copy.hpp"
+#include "depth.hpp"
+#include "discovery.hpp"
+#include "dispatch.hpp"
+#include "exporter.hpp"
+#include "fanout.hpp"
+#include "fiducial.hpp"
+#include "frame_alloc.hpp"
+#include "frame_view.hpp"
+#include "latency.hpp"
+#include "logger.hpp"
+#include "motion.hpp"
+#include "pipeline.hpp"
+#include "projection.hpp"
+#include "sensor.hpp"
+#include "stereo.hpp"
+#include "tensor.hpp"
+#include "tiles.hpp"
 
 struct or_camera_pipe {
     gazebo::transport::NodePtr node;
     gazebo::transport::SubscriberPtr sub;
+    std::string topic;          // of the frames, subscribed again on activation
+    bool transport = false;     // gazebo client set up, until disconnect()
 };
 
 struct or_camera_data {
+    uint16_t w;
+    uint16_t h;
     uint64_t l;
+    uint16_t c;     // channels
+    uint16_t d;     // bytes per channel
     uint8_t* data;
+    frame_memory mem;           // backing of data
     bool prompt_size_error;
     bool new_frame = false;
+    uint64_t received = 0;      // frames of the expected size
     std::mutex m;
     std::condition_variable cv;
 
     timeval tv;
+    std::chrono::steady_clock::time_point arrival;  // of the message in cb
+    std::chrono::steady_clock::time_point ready;    // frame copied
+
+    // sim time schedule, frames before the next slot are skipped
+    double sim_period = 0;      // 0 to publish every frame
+    double next_slot = 0;
+    uint32_t skipped = 0;
 
     or_camera_data(uint16_t w, uint16_t h, uint16_t c) { set_size(w, h, c); }
-    ~or_camera_data() { delete data; }
 
-    void set_size(uint16_t w, uint16_t h, uint16_t c)
+    // the caller holds m, or the callback is not subscribed yet
+    bool set_size(uint16_t w, uint16_t h, uint16_t c, uint16_t d = 1)
     {
-        l = h * w * c;
-        data = new uint8_t[l];
+        this->w = w;
+        this->h = h;
+        this->c = c;
+        this->d = d;
+        l = (uint64_t)h * w * c * d;
         prompt_size_error = false;
+
+        bool ok = mem.allocate(l);
+        data = mem.ptr;
+        if (!ok)
+            l = 0;      // every frame is rejected by the size check
+        return ok;
+    }
+
+    // the caller holds m
+    frame_view view() { return frame_view(data, w, h, c, d, frame_view::transport); }
+
+    // keep the first frame at or after each multiple of sim_period, so that
+    // the publishing rate does not depend on the real time factor; slot is
+    // the one following the frame, to commit once the frame is taken
+    bool on_schedule(const gazebo::msgs::Time& t, double& slot)
+    {
+        slot = next_slot;
+        if (sim_period <= 0)
+            return true;
+
+        double s = t.sec() + t.nsec() * 1e-9;
+        // a stamp more than one period before the slot means the world was reset
+        if (s + 1e-6 < next_slot && next_slot - s <= sim_period)
+        {
+            skipped++;
+            return false;
+        }
+        slot = (std::floor(s / sim_period + 1e-6) + 1) * sim_period;
+        return true;
     }
 
     void cb(ConstImageStampedPtr &_msg)
     {
-        if (_msg->image().data().length() == l)
+        auto t = std::chrono::steady_clock::now();
+
+        // a frame of another shape may have the same length
+        if (_msg->image().width() == w && _msg->image().height() == h &&
+            _msg->image().data().length() == l)
         {
             std::unique_lock<std::mutex> lock(this->m);
+
+            double slot;
+            if (!on_schedule(_msg->time(), slot))
+                return;
+
             // the main thread releases the lock between codels wait and pub,
             // therefore the callback might retrieve it before the previous frame is published
             // (although its very unlikely)
@@ -77,7 +155,11 @@ struct or_camera_data {
             if (!new_frame)
             {
                 gettimeofday(&(tv), NULL);
-                memcpy(data, _msg->image().data().c_str(), l); // sizeof *this->data == 1
+                frame_copy(data, _msg->image().data().c_str(), l); // sizeof *this->data == 1
+                next_slot = slot;   // a dropped frame leaves its slot open
+                arrival = t;
+                ready = std::chrono::steady_clock::now();
+                received++;
                 new_frame = true;
                 lock.unlock();
                 cv.notify_all();
@@ -93,4 +175,14 @@ struct or_camera_data {
     }
 };
 
+struct camgazebo_reproj_s {
+    bool dirty = true;          // models or field of view set since the maps were built
+    uint16_t w = 0, h = 0;      // size the maps were built for
+    cv::Mat map1;
+    cv::Mat map2;
+};
+
+void compute_calib(or_sensor_intrinsics* intr, float hfov, or_camera_info_size_s size,
+                   camgazebo_projection model, const float kb[4]);
+
 #endif /* H_CAMGAZEBO_CODELS */
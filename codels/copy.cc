@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include "accamgazebo.h"
+
+#include "copy.hpp"
+#include "dispatch.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define CAMGAZEBO_X86
+#endif
+
+size_t frame_copy_threshold = 1 << 20;
+
+
+/* --- Streaming implementations ------------------------------------------ */
+
+#ifdef CAMGAZEBO_X86
+
+// the destination is aligned with a regular copy of its head, the source is
+// read with unaligned loads
+
+void
+stream_copy_sse2(void* dst, const void* src, size_t n)
+{
+    uint8_t* d = (uint8_t*)dst;
+    const uint8_t* s = (const uint8_t*)src;
+    size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+    if (head > n)
+        head = n;
+
+    memcpy(d, s, head);
+    d += head; s += head; n -= head;
+
+    for (; n >= 64; n -= 64, d += 64, s += 64)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)s);
+        __m128i b = _mm_loadu_si128((const __m128i*)(s + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(s + 32));
+        __m128i e = _mm_loadu_si128((const __m128i*)(s + 48));
+        _mm_stream_si128((__m128i*)d, a);
+        _mm_stream_si128((__m128i*)(d + 16), b);
+        _mm_stream_si128((__m128i*)(d + 32), c);
+        _mm_stream_si128((__m128i*)(d + 48), e);
+    }
+    _mm_sfence();
+    memcpy(d, s, n);
+}
+
+__attribute__((target("avx2"))) void
+stream_copy_avx2(void* dst, const void* src, size_t n)
+{
+    uint8_t* d = (uint8_t*)dst;
+    const uint8_t* s = (const uint8_t*)src;
+    size_t head = (32 - ((uintptr_t)d & 31)) & 31;
+    if (head > n)
+        head = n;
+
+    memcpy(d, s, head);
+    d += head; s += head; n -= head;
+
+    for (; n >= 128; n -= 128, d += 128, s += 128)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i*)s);
+        __m256i b = _mm256_loadu_si256((const __m256i*)(s + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i*)(s + 64));
+        __m256i e = _mm256_loadu_si256((const __m256i*)(s + 96));
+        _mm256_stream_si256((__m256i*)d, a);
+        _mm256_stream_si256((__m256i*)(d + 32), b);
+        _mm256_stream_si256((__m256i*)(d + 64), c);
+        _mm256_stream_si256((__m256i*)(d + 96), e);
+    }
+    _mm_sfence();
+    memcpy(d, s, n);
+}
+
+__attribute__((target("avx512f"))) void
+stream_copy_avx512(void* dst, const void* src, size_t n)
+{
+    uint8_t* d = (uint8_t*)dst;
+    const uint8_t* s = (const uint8_t*)src;
+    size_t head = (64 - ((uintptr_t)d & 63)) & 63;
+    if (head > n)
+        head = n;
+
+    memcpy(d, s, head);
+    d += head; s += head; n -= head;
+
+    for (; n >= 256; n -= 256, d += 256, s += 256)
+    {
+        __m512i a = _mm512_loadu_si512((const void*)s);
+        __m512i b = _mm512_loadu_si512((const void*)(s + 64));
+        __m512i c = _mm512_loadu_si512((const void*)(s + 128));
+        __m512i e = _mm512_loadu_si512((const void*)(s + 192));
+        _mm512_stream_si512((__m512i*)d, a);
+        _mm512_stream_si512((__m512i*)(d + 64), b);
+        _mm512_stream_si512((__m512i*)(d + 128), c);
+        _mm512_stream_si512((__m512i*)(d + 192), e);
+    }
+    _mm_sfence();
+    memcpy(d, s, n);
+}
+
+#endif
+
+
+/* --- frame_copy -------------------------------------------------------- */
+
+// no portable streaming store, the caches are left to the hardware
+void
+stream_copy_scalar(void* dst, const void* src, size_t n)
+{
+    memcpy(dst, src, n);
+}
+
+void
+frame_copy(void* dst, const void* src, size_t n)
+{
+    if (n < frame_copy_threshold)
+        memcpy(dst, src, n);
+    else
+        kernels.stream_copy(dst, src, n);
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#ifndef H_CAMGAZEBO_COPY
+#define H_CAMGAZEBO_COPY
+
+#include <cstddef>
+
+// Full frame copy. Above the threshold, the destination is written with
+// non-temporal stores, which bypass the caches: a frame copy does not then
+// evict the working set of the other threads of the socket (gzserver
+// rendering among them). Smaller copies go through memcpy. The streaming
+// implementation is selected by the kernel dispatch table.
+//
+// Only for a destination that is not read right after, i.e. the transport
+// buffer filled by the gazebo callback. The publication stages read the
+// raw port frame after its copy, which must then stay in the caches
+// (test/copy_bench compares both).
+void frame_copy(void* dst, const void* src, size_t n);
+
+// Copies of at least this many bytes stream, 1MB by default: a frame
+// beyond VGA size is a sizable share of the per core last level cache.
+extern size_t frame_copy_threshold;
+
+#endif /* H_CAMGAZEBO_COPY */
@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include "accamgazebo.h"
+
+#include "depth.hpp"
+#include "dispatch.hpp"
+#include "pipeline.hpp"
+
+#include <gazebo/common/Image.hh>
+#include <opencv2/opencv.hpp>
+
+#include <err.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+
+/* --- Depth stream ------------------------------------------------------- */
+
+void
+camgazebo_depth_s::cb(ConstImageStampedPtr &_msg)
+{
+    const gazebo::msgs::Image &img = _msg->image();
+    const std::string &raw = img.data();
+    size_t n = img.width() * img.height();
+
+    std::lock_guard<std::mutex> guard(m);
+
+    if (img.pixel_format() == gazebo::common::Image::R_FLOAT32 && raw.length() == n * sizeof(float))
+    {
+        back.resize(n);
+        memcpy(back.data(), raw.data(), raw.length());
+    }
+    else if (img.pixel_format() == gazebo::common::Image::L_INT16 && raw.length() == n * sizeof(uint16_t))
+    {
+        // 16 bits depth images are in millimeters
+        back.resize(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            uint16_t mm;
+            memcpy(&mm, raw.data() + i * sizeof(mm), sizeof(mm));
+            back[i] = mm * 1e-3f;
+        }
+    }
+    else
+    {
+        if (!prompt_format_error)
+        {
+            warnx("unsupported depth image; expecting R_FLOAT32 (m) or L_INT16 (mm)");
+            prompt_format_error = true;
+        }
+        return;
+    }
+
+    w = img.width();
+    h = img.height();
+    ts.sec = _msg->time().sec();
+    ts.nsec = _msg->time().nsec();
+    new_depth = true;
+}
+
+// Swap the latest depth image in, without copying. Returns false if no new
+// image arrived since the previous call.
+bool
+camgazebo_depth_s::fetch()
+{
+    std::lock_guard<std::mutex> guard(m);
+
+    if (!new_depth)
+        return false;
+
+    back.swap(front);
+    fw = w;
+    fh = h;
+    fts = ts;
+    new_depth = false;
+    return true;
+}
+
+
+/* --- Ray tables --------------------------------------------------------- */
+
+void
+camgazebo_depth_s::update_rays(const or_sensor_intrinsics* intr)
+{
+    if (!rays_dirty && rays_w == fw && rays_h == fh)
+        return;
+    rays_dirty = false;
+    rays_w = fw;
+    rays_h = fh;
+
+    size_t n = fw * fh;
+    std::vector<cv::Point2f> px(n);
+    for (uint16_t v = 0; v < fh; v++)
+        for (uint16_t u = 0; u < fw; u++)
+            px[v * fw + u] = cv::Point2f(u, v);
+
+    cv::Matx33d K(intr->calib.fx, intr->calib.gamma, intr->calib.cx,
+                  0, intr->calib.fy, intr->calib.cy,
+                  0, 0, 1);
+    cv::Matx<double, 1, 5> D(intr->disto.k1, intr->disto.k2, intr->disto.p1, intr->disto.p2, intr->disto.k3);
+
+    // normalized coordinates of each pixel, i.e. its ray at z = 1
+    std::vector<cv::Point2f> ray;
+    cv::undistortPoints(px, ray, K, D);
+
+    rx.resize(n);
+    ry.resize(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        rx[i] = ray[i].x;
+        ry[i] = ray[i].y;
+    }
+}
+
+
+/* --- Point projection kernels ----------------------------------------- */
+
+void
+project_points_scalar(const float* z, const float* rx, const float* ry,
+                      const uint32_t* rgb, size_t n, float* out)
+{
+    size_t stride = rgb ? 4 : 3;
+    for (size_t i = 0; i < n; i++)
+    {
+        float* o = out + i * stride;
+        o[0] = z[i] * rx[i];
+        o[1] = z[i] * ry[i];
+        o[2] = z[i];
+        if (rgb)
+            memcpy(&o[3], &rgb[i], sizeof(float));
+    }
+}
+
+#if defined(__SSE2__)
+void
+project_points_sse2(const float* z, const float* rx, const float* ry,
+                    const uint32_t* rgb, size_t n, float* out)
+{
+    size_t stride = rgb ? 4 : 3;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 pz = _mm_loadu_ps(z + i);
+        __m128 px = _mm_mul_ps(pz, _mm_loadu_ps(rx + i));
+        __m128 py = _mm_mul_ps(pz, _mm_loadu_ps(ry + i));
+        __m128 pc = rgb ? _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(rgb + i))) : _mm_setzero_ps();
+
+        // four points, one per register
+        _MM_TRANSPOSE4_PS(px, py, pz, pc);
+
+        float* o = out + i * stride;
+        _mm_storeu_ps(o, px);
+        _mm_storeu_ps(o + stride, py);
+        _mm_storeu_ps(o + 2*stride, pz);
+        _mm_storeu_ps(o + 3*stride, pc);
+    }
+    project_points_scalar(z + i, rx + i, ry + i, rgb ? rgb + i : nullptr, n - i, out + i * stride);
+}
+#endif
+
+#if defined(__ARM_NEON)
+void
+project_points_neon(const float* z, const float* rx, const float* ry,
+                    const uint32_t* rgb, size_t n, float* out)
+{
+    size_t stride = rgb ? 4 : 3;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        float32x4_t pz = vld1q_f32(z + i);
+        float32x4_t px = vmulq_f32(pz, vld1q_f32(rx + i));
+        float32x4_t py = vmulq_f32(pz, vld1q_f32(ry + i));
+
+        // interleaving stores
+        if (rgb)
+        {
+            float32x4x4_t p = { { px, py, pz, vreinterpretq_f32_u32(vld1q_u32(rgb + i)) } };
+            vst4q_f32(out + i * stride, p);
+        }
+        else
+        {
+            float32x4x3_t p = { { px, py, pz } };
+            vst3q_f32(out + i * stride, p);
+        }
+    }
+    project_points_scalar(z + i, rx + i, ry + i, rgb ? rgb + i : nullptr, n - i, out + i * stride);
+}
+#endif
+
+
+/* --- Point cloud -------------------------------------------------------- */
+
+// Fill out with packed xyz (or xyzrgb, rgb packed as float) points and
+// return their count. out must hold fw*fh points plus one float: the SIMD
+// paths write xyz points with overlapping 4-floats stores.
+uint32_t
+camgazebo_depth_s::compute(const uint8_t* color, const pixel_pipeline* pipeline, float* out)
+{
+    size_t n = fw * fh;
+    size_t stride = rgb ? 4 : 3;
+    const float* d = front.data();
+
+    if (rgb)
+    {
+        packed_rgb.resize(n);
+        if (color)
+            pipeline->pack_rgb(color, n, packed_rgb.data());
+        else
+            std::fill(packed_rgb.begin(), packed_rgb.end(), 0);
+    }
+
+    kernels.project_points(d, rx.data(), ry.data(), rgb ? packed_rgb.data() : nullptr, n, out);
+
+    // drop invalid and out of range points, and keep the first point of
+    // each voxel when downsampling
+    if (voxel > 0)
+    {
+        voxels.clear();
+        voxels.reserve(n / 4);
+    }
+
+    uint32_t count = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        const float* p = out + i * stride;
+        if (!std::isfinite(p[2]) || p[2] <= 0 || (max_range > 0 && p[2] > max_range))
+            continue;
+
+        if (voxel > 0)
+        {
+            uint64_t key =
+                  ((uint64_t)((int64_t)std::floor(p[0] / voxel) & 0x1fffff) << 42)
+                | ((uint64_t)((int64_t)std::floor(p[1] / voxel) & 0x1fffff) << 21)
+                |  (uint64_t)((int64_t)std::floor(p[2] / voxel) & 0x1fffff);
+            if (!voxels.insert(key).second)
+                continue;
+        }
+
+        if (count != i)
+            memmove(out + count * stride, p, stride * sizeof(float));
+        count++;
+    }
+
+    return count;
+}
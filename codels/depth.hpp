@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#ifndef H_CAMGAZEBO_DEPTH
+#define H_CAMGAZEBO_DEPTH
+
+#include "camgazebo_c_types.h"
+
+#include <gazebo/transport/transport.hh>
+#include <gazebo/msgs/msgs.hh>
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+struct pixel_pipeline;
+
+struct camgazebo_depth_s {
+    gazebo::transport::SubscriberPtr sub;
+
+    // latest depth image (meters), written by cb and swapped in by fetch
+    std::mutex m;
+    std::vector<float> back;
+    uint16_t w = 0, h = 0;
+    or_time_ts ts;
+    bool new_depth = false;
+    bool prompt_format_error = false;
+
+    std::vector<float> front;
+    uint16_t fw = 0, fh = 0;
+    or_time_ts fts;
+
+    // cloud settings
+    bool enabled = false;
+    bool rgb = false;
+    float voxel = 0;
+    float max_range = 0;
+
+    // per-pixel rays, rebuilt when the calibration they derive from is set
+    // or the depth image size changes
+    bool rays_dirty = true;
+    uint16_t rays_w = 0, rays_h = 0;
+    std::vector<float> rx;
+    std::vector<float> ry;
+
+    std::vector<uint32_t> packed_rgb;
+    std::unordered_set<uint64_t> voxels;
+
+    void cb(ConstImageStampedPtr &_msg);
+    bool fetch();
+    void update_rays(const or_sensor_intrinsics* intr);
+    uint32_t compute(const uint8_t* color, const pixel_pipeline* pipeline, float* out);
+};
+
+#endif /* H_CAMGAZEBO_DEPTH */
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include "accamgazebo.h"
+
+#include "discovery.hpp"
+
+#include <gazebo/transport/transport.hh>
+#include <gazebo/msgs/msgs.hh>
+
+#include <err.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// gazebo::common::Image::PixelFormat names
+static const char* pixel_formats[] = {
+    "UNKNOWN", "L_INT8", "L_INT16", "RGB_INT8", "RGBA_INT8", "BGRA_INT8",
+    "RGB_INT16", "RGB_INT32", "BGR_INT8", "BGR_INT16", "BGR_INT32",
+    "R_FLOAT16", "RGB_FLOAT16", "R_FLOAT32", "RGB_FLOAT32",
+    "BAYER_RGGB8", "BAYER_RGGR8", "BAYER_GBRG8", "BAYER_GRBG8"
+};
+
+// First frame of each probed topic. Shared with the subscriber callbacks,
+// which may still run once the caller gave up waiting.
+struct camera_probe {
+    struct entry {
+        uint16_t width = 0;
+        uint16_t height = 0;
+        std::string format;
+        bool done = false;
+    };
+
+    std::mutex m;
+    std::condition_variable cv;
+    std::vector<entry> entries;
+    size_t pending = 0;
+    bool closed = false;
+
+    void cb(size_t i, ConstImageStampedPtr &_msg)
+    {
+        std::lock_guard<std::mutex> guard(m);
+        entry& e = entries[i];
+        if (closed || e.done)
+            return;
+
+        uint32_t pf = _msg->image().pixel_format();
+        e.width = _msg->image().width();
+        e.height = _msg->image().height();
+        e.format = pf < sizeof(pixel_formats) / sizeof(*pixel_formats) ? pixel_formats[pf] : "UNKNOWN";
+        e.done = true;
+        pending--;
+        cv.notify_all();
+    }
+};
+
+
+/* --- list_camera_topics ------------------------------------------------- */
+
+void
+list_camera_topics(sequence64_camgazebo_camera_topic* cameras, double timeout)
+{
+    std::list<std::string> topics = gazebo::transport::getAdvertisedTopics("gazebo.msgs.ImageStamped");
+
+    cameras->_length = 0;
+    for (const std::string& t : topics)
+    {
+        if (cameras->_length == cameras->_maximum)
+        {
+            warnx("more than %u cameras, list truncated", cameras->_maximum);
+            break;
+        }
+        camgazebo_camera_topic* c = &cameras->_buffer[cameras->_length++];
+        snprintf(c->topic, sizeof(c->topic), "%s", t.c_str());
+        c->width = c->height = 0;
+        c->format[0] = '\0';
+    }
+
+    if (timeout <= 0 || !cameras->_length)
+        return;
+
+    // subscribe to all topics at once and wait for a frame from each
+    gazebo::transport::NodePtr node(new gazebo::transport::Node());
+    node->Init();
+
+    std::shared_ptr<camera_probe> probe = std::make_shared<camera_probe>();
+    probe->entries.resize(cameras->_length);
+    probe->pending = cameras->_length;
+
+    std::vector<gazebo::transport::SubscriberPtr> subs;
+    for (uint32_t i = 0; i < cameras->_length; i++)
+    {
+        std::function<void (ConstImageStampedPtr&)> cb =
+            [probe, i](ConstImageStampedPtr& msg) { probe->cb(i, msg); };
+        subs.push_back(node->Subscribe<gazebo::msgs::ImageStamped>(cameras->_buffer[i].topic, cb));
+    }
+
+    std::unique_lock<std::mutex> lock(probe->m);
+    probe->cv.wait_for(lock, std::chrono::duration<double>(timeout),
+                       [&probe] { return probe->pending == 0; });
+
+    probe->closed = true;
+    for (uint32_t i = 0; i < cameras->_length; i++)
+    {
+        const camera_probe::entry& e = probe->entries[i];
+        camgazebo_camera_topic* c = &cameras->_buffer[i];
+        c->width = e.width;
+        c->height = e.height;
+        snprintf(c->format, sizeof(c->format), "%s", e.format.c_str());
+    }
+    lock.unlock();
+
+    subs.clear();
+    node->Fini();
+}
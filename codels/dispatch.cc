@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include "accamgazebo.h"
+
+#include "dispatch.hpp"
+
+#if defined(__x86_64__)
+#define CAMGAZEBO_X86
+#endif
+
+kernel_table kernels = { camgazebo_isa_scalar, stream_copy_scalar, project_points_scalar, sad_scalar, row_accumulate_scalar };
+
+camgazebo_isa
+isa_detect()
+{
+#if defined(CAMGAZEBO_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return camgazebo_isa_avx512;
+    if (__builtin_cpu_supports("avx2"))
+        return camgazebo_isa_avx2;
+    // sse2 is part of x86-64
+    return camgazebo_isa_sse2;
+#elif defined(__ARM_NEON)
+    return camgazebo_isa_neon;
+#endif
+    return camgazebo_isa_scalar;
+}
+
+bool
+isa_select(camgazebo_isa isa)
+{
+    camgazebo_isa best = isa_detect();
+
+    if (isa == camgazebo_isa_auto)
+        isa = best;
+    // x86 levels are ordered, neon stands alone
+    else if (isa != camgazebo_isa_scalar
+             && (best == camgazebo_isa_neon ? isa != best : isa == camgazebo_isa_neon || isa > best))
+        return false;
+
+    kernel_table k = { isa, stream_copy_scalar, project_points_scalar, sad_scalar, row_accumulate_scalar };
+    switch (isa)
+    {
+#if defined(CAMGAZEBO_X86)
+        case camgazebo_isa_avx512:
+            k.stream_copy = stream_copy_avx512;
+            k.project_points = project_points_sse2;
+            k.sad = sad_avx2;
+            k.row_accumulate = row_accumulate_avx2;
+            break;
+        case camgazebo_isa_avx2:
+            k.stream_copy = stream_copy_avx2;
+            k.project_points = project_points_sse2;
+            k.sad = sad_avx2;
+            k.row_accumulate = row_accumulate_avx2;
+            break;
+        case camgazebo_isa_sse2:
+            k.stream_copy = stream_copy_sse2;
+            k.project_points = project_points_sse2;
+            k.sad = sad_sse2;
+            k.row_accumulate = row_accumulate_sse2;
+            break;
+#elif defined(__ARM_NEON)
+        case camgazebo_isa_neon:
+            k.project_points = project_points_neon;
+            k.sad = sad_neon;
+            k.row_accumulate = row_accumulate_neon;
+            break;
+#endif
+        default:
+            break;
+    }
+    kernels = k;
+    return true;
+}
+
+const char*
+isa_name(camgazebo_isa isa)
+{
+    switch (isa)
+    {
+        case camgazebo_isa_auto:    return "auto";
+        case camgazebo_isa_scalar:  return "scalar";
+        case camgazebo_isa_sse2:    return "sse2";
+        case camgazebo_isa_avx2:    return "avx2";
+        case camgazebo_isa_avx512:  return "avx512";
+        case camgazebo_isa_neon:    return "neon";
+    }
+    return "unknown";
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#ifndef H_CAMGAZEBO_DISPATCH
+#define H_CAMGAZEBO_DISPATCH
+
+#include "camgazebo_c_types.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Vectorized kernels, with implementations per instruction set. The table
+// is filled at camgz_start with the best implementations the cpu supports,
+// so that a single binary runs on every host; it can be restricted to a
+// lower level with set_dispatch for testing. A kernel without an
+// implementation at the selected level uses the closest lower one.
+struct kernel_table {
+    camgazebo_isa isa;
+
+    // copy n bytes with non-temporal stores
+    void (*stream_copy)(void* dst, const void* src, size_t n);
+
+    // n points (z rx, z ry, z), followed by rgb as a float if rgb is not
+    // null; out must hold one float more than the points
+    void (*project_points)(const float* z, const float* rx, const float* ry,
+                           const uint32_t* rgb, size_t n, float* out);
+
+    // sum of absolute differences of n bytes
+    uint64_t (*sad)(const uint8_t* a, const uint8_t* b, size_t n);
+
+    // acc[i] += w * src[i] for n bytes of src
+    void (*row_accumulate)(float* acc, const uint8_t* src, float w, size_t n);
+};
+
+extern kernel_table kernels;
+
+camgazebo_isa isa_detect();
+// isa_auto selects the detected level; false if the cpu lacks isa
+bool isa_select(camgazebo_isa isa);
+const char* isa_name(camgazebo_isa isa);
+
+// implementations, next to their callers
+void stream_copy_scalar(void* dst, const void* src, size_t n);
+void stream_copy_sse2(void* dst, const void* src, size_t n);
+void stream_copy_avx2(void* dst, const void* src, size_t n);
+void stream_copy_avx512(void* dst, const void* src, size_t n);
+
+void project_points_scalar(const float* z, const float* rx, const float* ry,
+                           const uint32_t* rgb, size_t n, float* out);
+void project_points_sse2(const float* z, const float* rx, const float* ry,
+                         const uint32_t* rgb, size_t n, float* out);
+void project_points_neon(const float* z, const float* rx, const float* ry,
+                         const uint32_t* rgb, size_t n, float* out);
+
+uint64_t sad_scalar(const uint8_t* a, const uint8_t* b, size_t n);
+uint64_t sad_sse2(const uint8_t* a, const uint8_t* b, size_t n);
+uint64_t sad_avx2(const uint8_t* a, const uint8_t* b, size_t n);
+uint64_t sad_neon(const uint8_t* a, const uint8_t* b, size_t n);
+
+void row_accumulate_scalar(float* acc, const uint8_t* src, float w, size_t n);
+void row_accumulate_sse2(float* acc, const uint8_t* src, float w, size_t n);
+void row_accumulate_avx2(float* acc, const uint8_t* src, float w, size_t n);
+void row_accumulate_neon(float* acc, const uint8_t* src, float w, size_t n);
+
+#endif /* H_CAMGAZEBO_DISPATCH */
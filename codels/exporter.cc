@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include "accamgazebo.h"
+
+#include "exporter.hpp"
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+
+#ifdef HAVE_LIBURING_H
+#include <liburing.h>
+#endif
+
+
+/* --- Control ------------------------------------------------------------ */
+
+bool
+camgazebo_exporter_s::start(const char* path)
+{
+    stop();
+
+    if (mkdir(path, 0755) == -1 && errno != EEXIST)
+        return false;
+
+    dir = path;
+    next_index = 0;
+    files = 0;
+    bytes = 0;
+    dropped = 0;
+    errors = 0;
+    queue.clear();
+
+#ifdef HAVE_LIBURING_H
+    struct io_uring* r = new struct io_uring;
+    if (io_uring_queue_init(2 * batch_max, r, 0) == 0)
+    {
+        ring = r;
+        uring = true;
+    }
+    else
+    {
+        delete r;
+        uring = false;
+    }
+#endif
+    if (!uring && !pool)
+        pool.reset(new worker_pool(4));
+
+    t_start = std::chrono::steady_clock::now();
+    running = true;
+    writer = std::thread(&camgazebo_exporter_s::run, this);
+    return true;
+}
+
+// Stop accepting frames, and return once everything queued is written.
+void
+camgazebo_exporter_s::stop()
+{
+    if (!writer.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard(m);
+        running = false;
+    }
+    cv.notify_all();
+    writer.join();
+    t_stop = std::chrono::steady_clock::now();
+
+#ifdef HAVE_LIBURING_H
+    if (ring)
+    {
+        io_uring_queue_exit((struct io_uring*)ring);
+        delete (struct io_uring*)ring;
+        ring = nullptr;
+    }
+    uring = false;
+#endif
+}
+
+double
+camgazebo_exporter_s::elapsed() const
+{
+    std::chrono::duration<double> d =
+        (running ? std::chrono::steady_clock::now() : t_stop) - t_start;
+    return d.count();
+}
+
+
+/* --- Producer ----------------------------------------------------------- */
+
+// Queue a frame without blocking; image is swapped with the buffer of the
+// queue slot so that no copy is made. Returns false if the frame was dropped.
+bool
+camgazebo_exporter_s::push(std::vector<uint8_t>& image, const char* ext, const or_sensor_frame* frame,
+                           const or_sensor_intrinsics* intr, const or_sensor_extrinsics* ext_calib,
+                           camgazebo_projection model, const float kb[4])
+{
+    job* j = queue.claim();
+    if (!j)
+    {
+        dropped++;
+        return false;
+    }
+
+    // D is the Brown-Conrady distortion of pinhole outputs, kb the
+    // coefficients of fisheye ones
+    static const char* models[] = { "pinhole", "equidistant", "kannala_brandt" };
+    bool fisheye = model == camgazebo_proj_kannala_brandt;
+    char sidecar[640];
+    snprintf(sidecar, sizeof(sidecar),
+             "{\"index\": %llu, \"sec\": %d, \"nsec\": %d, \"width\": %u, \"height\": %u,"
+             " \"model\": \"%s\", \"K\": [%g, %g, %g, %g, %g], \"D\": [%g, %g, %g, %g, %g],"
+             " \"kb\": [%g, %g, %g, %g], \"extrinsics\": [%g, %g, %g, %g, %g, %g]}\n",
+             (unsigned long long)next_index, frame->ts.sec, frame->ts.nsec, frame->width, frame->height,
+             models[model],
+             intr->calib.fx, intr->calib.fy, intr->calib.cx, intr->calib.cy, intr->calib.gamma,
+             intr->disto.k1, intr->disto.k2, intr->disto.k3, intr->disto.p1, intr->disto.p2,
+             fisheye ? kb[0] : 0, fisheye ? kb[1] : 0, fisheye ? kb[2] : 0, fisheye ? kb[3] : 0,
+             ext_calib->trans.tx, ext_calib->trans.ty, ext_calib->trans.tz,
+             ext_calib->rot.roll, ext_calib->rot.pitch, ext_calib->rot.yaw);
+
+    j->index = next_index++;
+    j->ext = ext;
+    j->image.swap(image);
+    j->sidecar = sidecar;
+    queue.commit();
+
+    { std::lock_guard<std::mutex> guard(m); }
+    cv.notify_one();
+    return true;
+}
+
+
+/* --- Writer thread ------------------------------------------------------ */
+
+static bool
+write_all(int fd, const void* buf, size_t len, off_t off = 0)
+{
+    while (len > 0)
+    {
+        ssize_t n = pwrite(fd, buf, len, off);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        buf = (const uint8_t*)buf + n;
+        len -= n;
+        off += n;
+    }
+    return true;
+}
+
+void
+camgazebo_exporter_s::run()
+{
+    std::vector<op> ops;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock, [this] { return !running || queue.size() > 0; });
+        }
+
+        size_t n = std::min(queue.size(), batch_max);
+        if (n == 0)
+        {
+            if (!running)
+                break;
+            continue;
+        }
+
+        ops.clear();
+        for (size_t i = 0; i < n; i++)
+        {
+            job* j = queue.peek(i);
+            char name[512];
+
+            snprintf(name, sizeof(name), "%s/%08llu%s", dir.c_str(), (unsigned long long)j->index, j->ext);
+            int fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd != -1)
+                ops.push_back({ fd, j->image.data(), j->image.size(), true });
+
+            snprintf(name, sizeof(name), "%s/%08llu.json", dir.c_str(), (unsigned long long)j->index);
+            int sfd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (sfd != -1)
+                ops.push_back({ sfd, j->sidecar.data(), j->sidecar.size(), false });
+
+            if (fd == -1 || sfd == -1)
+                errors++;
+        }
+
+        write_ops(ops);
+
+        for (op& o : ops)
+            close(o.fd);
+        queue.pop(n);
+    }
+}
+
+// Write a batch of whole files and wait for completion.
+void
+camgazebo_exporter_s::write_ops(std::vector<op>& ops)
+{
+#ifdef HAVE_LIBURING_H
+    if (uring)
+    {
+        struct io_uring* r = (struct io_uring*)ring;
+
+        for (size_t i = 0; i < ops.size(); i++)
+        {
+            struct io_uring_sqe* sqe = io_uring_get_sqe(r);
+            io_uring_prep_write(sqe, ops[i].fd, ops[i].buf, ops[i].len, 0);
+            io_uring_sqe_set_data(sqe, (void*)(uintptr_t)i);
+        }
+        io_uring_submit(r);
+
+        for (size_t k = 0; k < ops.size(); k++)
+        {
+            struct io_uring_cqe* cqe;
+            if (io_uring_wait_cqe(r, &cqe) < 0)
+            {
+                errors++;
+                continue;
+            }
+            op& o = ops[(uintptr_t)io_uring_cqe_get_data(cqe)];
+            size_t done = cqe->res < 0 ? 0 : cqe->res;
+            io_uring_cqe_seen(r, cqe);
+
+            // finish short or failed writes synchronously, they are rare on
+            // regular files
+            if (done < o.len && !write_all(o.fd, (const uint8_t*)o.buf + done, o.len - done, done))
+                errors++;
+            else
+                done_op(o);
+        }
+        return;
+    }
+#endif
+
+    std::atomic<size_t> left(ops.size());
+    std::mutex dm;
+    std::condition_variable dcv;
+
+    for (op& o : ops)
+        pool->submit([&, o]() {
+            if (write_all(o.fd, o.buf, o.len))
+                done_op(o);
+            else
+                errors++;
+
+            if (--left == 0)
+            {
+                std::lock_guard<std::mutex> guard(dm);
+                dcv.notify_one();
+            }
+        });
+
+    std::unique_lock<std::mutex> lock(dm);
+    dcv.wait(lock, [&] { return left == 0; });
+}
+
+void
+camgazebo_exporter_s::done_op(const op& o)
+{
+    bytes += o.len;
+    if (o.image)
+        files++;
+}
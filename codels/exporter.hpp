@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#ifndef H_CAMGAZEBO_EXPORTER
+#define H_CAMGAZEBO_EXPORTER
+
+#include "camgazebo_c_types.h"
+
+#include "spsc_queue.hpp"
+#include "worker_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Dataset export: the main task queues encoded frames and their sidecar,
+// a writer thread stores them in batches with io_uring when available, or
+// with parallel writes on a small worker pool otherwise.
+struct camgazebo_exporter_s {
+    struct job {
+        uint64_t index;
+        const char* ext;
+        std::vector<uint8_t> image;
+        std::string sidecar;
+    };
+
+    static const size_t batch_max = 32;
+
+    std::string dir;
+    uint64_t next_index = 0;
+    spsc_queue<job, 64> queue;
+
+    std::atomic<bool> running{false};
+    std::thread writer;
+    std::mutex m;
+    std::condition_variable cv;
+    bool uring = false;
+
+    std::atomic<uint64_t> files{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint32_t> dropped{0};
+    std::atomic<uint32_t> errors{0};
+    std::chrono::steady_clock::time_point t_start;
+    std::chrono::steady_clock::time_point t_stop;
+
+    ~camgazebo_exporter_s() { stop(); }
+
+    bool start(const char* path);
+    void stop();
+    bool push(std::vector<uint8_t>& image, const char* ext, const or_sensor_frame* frame,
+              const or_sensor_intrinsics* intr, const or_sensor_extrinsics* ext_calib,
+              camgazebo_projection model, const float kb[4]);
+    double elapsed() const;
+
+  private:
+    struct op {
+        int fd;
+        const void* buf;
+        size_t len;
+        bool image;     // counted in files, sidecars are not
+    };
+
+    void run();
+    void write_ops(std::vector<op>& ops);
+    void done_op(const op& o);
+    std::unique_ptr<worker_pool> pool;
+#ifdef HAVE_LIBURING_H
+    void* ring = nullptr;
+#endif
+};
+
+#endif /* H_CAMGAZEBO_EXPORTER */
@@ -0,0 +1,374 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include "accamgazebo.h"
+
+#include "fanout.hpp"
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <err.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+/* --- Server control ----------------------------------------------------- */
+
+bool
+camgazebo_fanout_s::start(const char* p)
+{
+    stop();
+
+    sockaddr_un addr;
+    if (strlen(p) >= sizeof(addr.sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, p);
+
+    // a stale socket of a previous run would make bind fail; anything else
+    // at that path, or a socket still served, is left alone
+    struct stat st;
+    if (lstat(p, &st) == 0)
+    {
+        bool served = true;
+        if (S_ISSOCK(st.st_mode))
+        {
+            int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            served = probe == -1 || connect(probe, (sockaddr*)&addr, sizeof(addr)) == 0;
+            if (probe != -1)
+                close(probe);
+        }
+        if (served)
+        {
+            errno = EADDRINUSE;
+            return false;
+        }
+        unlink(p);
+    }
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd == -1)
+        return false;
+
+    if (bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) == -1
+        || listen(listen_fd, 8) == -1
+        || pipe2(wake, O_NONBLOCK | O_CLOEXEC) == -1)
+    {
+        int e = errno;
+        close(listen_fd);
+        listen_fd = -1;
+        errno = e;
+        return false;
+    }
+
+    path = p;
+    clients = 0;
+    sent = 0;
+    dropped = 0;
+    encodes = 0;
+    has_pending = false;
+    stopping = false;
+    server = std::thread(&camgazebo_fanout_s::run, this);
+    return true;
+}
+
+void
+camgazebo_fanout_s::stop()
+{
+    if (!server.joinable())
+        return;
+
+    stopping = true;
+    if (write(wake[1], "", 1) == -1) { /* poll times out anyway */ }
+    server.join();
+
+    for (client& c : conns)
+        close(c.fd);
+    conns.clear();
+    clients = 0;
+    due = INT64_MAX;
+
+    close(listen_fd);
+    close(wake[0]);
+    close(wake[1]);
+    listen_fd = wake[0] = wake[1] = -1;
+    unlink(path.c_str());
+}
+
+
+/* --- Producer ----------------------------------------------------------- */
+
+void
+camgazebo_fanout_s::push(const frame_view& f, const or_time_ts& ts, uint32_t seq)
+{
+    if (std::chrono::steady_clock::now().time_since_epoch().count() < due)
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard(m);
+        pending.pixels.resize(f.size());
+        f.copy_to(frame_view(pending.pixels.data(), f.w, f.h, f.c, f.d, frame_view::scratch));
+        pending.w = f.w;
+        pending.h = f.h;
+        pending.c = f.c;
+        pending.d = f.d;
+        pending.ts = ts;
+        pending.seq = seq;
+        has_pending = true;
+    }
+    if (write(wake[1], "", 1) == -1) { /* already woken */ }
+}
+
+
+/* --- Server thread ------------------------------------------------------ */
+
+void
+camgazebo_fanout_s::run()
+{
+    std::vector<pollfd> fds;
+
+    while (!stopping)
+    {
+        fds.clear();
+        fds.push_back({ wake[0], POLLIN, 0 });
+        fds.push_back({ listen_fd, POLLIN, 0 });
+        for (client& c : conns)
+            fds.push_back({ c.fd, (short)(POLLIN | (c.queue.empty() ? 0 : POLLOUT)), 0 });
+
+        if (poll(fds.data(), fds.size(), 1000) == -1 && errno != EINTR)
+        {
+            warn("fanout poll");
+            break;
+        }
+
+        char drain[64];
+        if (fds[0].revents & POLLIN)
+            while (read(wake[0], drain, sizeof(drain)) > 0);
+
+        for (size_t i = 0; i < conns.size(); i++)
+        {
+            short ev = fds[i + 2].revents;
+            if (ev & (POLLIN | POLLHUP | POLLERR))
+                negotiate(conns[i]);
+            if (ev & POLLOUT)
+                flush(conns[i]);
+        }
+
+        if (fds[1].revents & POLLIN)
+        {
+            int fd;
+            while ((fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1)
+            {
+                conns.push_back(client());
+                conns.back().fd = fd;
+            }
+        }
+
+        bool got = false;
+        {
+            std::lock_guard<std::mutex> guard(m);
+            if (has_pending)
+            {
+                std::swap(pending, current);
+                has_pending = false;
+                got = true;
+            }
+        }
+        if (got)
+            distribute(current);
+
+        for (size_t i = 0; i < conns.size();)
+            if (conns[i].closed)
+            {
+                close(conns[i].fd);
+                conns.erase(conns.begin() + i);
+            }
+            else
+                i++;
+        clients = conns.size();
+
+        int64_t next = INT64_MAX;
+        for (const client& c : conns)
+            next = std::min<int64_t>(next, c.next.time_since_epoch().count());
+        due = next;
+    }
+}
+
+// read settings lines; a connection closed by the client is marked closed
+void
+camgazebo_fanout_s::negotiate(client& c)
+{
+    char buf[256];
+    ssize_t n;
+
+    while ((n = recv(c.fd, buf, sizeof(buf), 0)) > 0)
+    {
+        c.line.append(buf, n);
+
+        size_t eol;
+        while ((eol = c.line.find('\n')) != std::string::npos)
+        {
+            std::string l = c.line.substr(0, eol);
+            c.line.erase(0, eol + 1);
+
+            char* save;
+            for (char* tok = strtok_r(&l[0], " \t\r", &save); tok; tok = strtok_r(NULL, " \t\r", &save))
+            {
+                double rate;
+                int q;
+                if (sscanf(tok, "rate=%lf", &rate) == 1)
+                    c.period = rate > 0 ? 1. / rate : 0;
+                else if (!strcmp(tok, "codec=raw"))
+                    c.codec = fanout_raw;
+                else if (!strcmp(tok, "codec=jpeg"))
+                    c.codec = fanout_jpeg;
+                else if (!strcmp(tok, "codec=png"))
+                    c.codec = fanout_png;
+                else if (sscanf(tok, "quality=%d", &q) == 1 && q >= 0 && q <= 100)
+                    c.quality = q;
+                else
+                    warnx("fanout: ignoring setting '%s'", tok);
+            }
+        }
+
+        // not a settings line
+        if (c.line.size() > 1024)
+            c.closed = true;
+    }
+
+    if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        c.closed = true;
+}
+
+void
+camgazebo_fanout_s::distribute(const frame& f)
+{
+    auto now = std::chrono::steady_clock::now();
+    std::map<std::pair<int, int>, message> encoded;
+
+    for (client& c : conns)
+    {
+        if (c.closed || now < c.next)
+            continue;
+
+        // the schedule does not drift, but does not burst after a stall
+        auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(c.period));
+        c.next += period;
+        if (c.next <= now)
+            c.next = now + period;
+
+        // jpeg only handles 8 bits images
+        fanout_codec codec = c.codec == fanout_jpeg && f.d != 1 ? fanout_png : c.codec;
+        std::pair<int, int> key(codec, codec == fanout_jpeg ? c.quality : 0);
+
+        auto e = encoded.find(key);
+        if (e == encoded.end())
+            e = encoded.emplace(key, encode(f, codec, c.quality)).first;
+        if (!e->second)
+            continue;
+
+        // the front message may be partially sent already
+        if (c.queue.size() >= queue_depth)
+        {
+            c.queue.erase(c.queue.begin() + (c.offset ? 1 : 0));
+            dropped++;
+        }
+        c.queue.push_back(e->second);
+        flush(c);
+    }
+}
+
+camgazebo_fanout_s::message
+camgazebo_fanout_s::encode(const frame& f, fanout_codec codec, int quality)
+{
+    std::shared_ptr<std::vector<uint8_t>> msg(new std::vector<uint8_t>(sizeof(fanout_header)));
+
+    if (codec == fanout_raw)
+        msg->insert(msg->end(), f.pixels.begin(), f.pixels.end());
+    else
+    {
+        std::vector<uint8_t> buf;
+        std::vector<int32_t> params;
+        if (codec == fanout_jpeg)
+            params = { cv::IMWRITE_JPEG_QUALITY, quality };
+
+        frame_view v(const_cast<uint8_t*>(f.pixels.data()), f.w, f.h, f.c, f.d, frame_view::scratch);
+        if (!cv::imencode(codec == fanout_jpeg ? ".jpg" : ".png", v.mat(), buf, params))
+            return message();
+        msg->insert(msg->end(), buf.begin(), buf.end());
+    }
+    encodes++;
+
+    fanout_header h;
+    memcpy(h.magic, "CGZF", 4);
+    h.codec = codec;
+    h.seq = f.seq;
+    h.sec = f.ts.sec;
+    h.nsec = f.ts.nsec;
+    h.width = f.w;
+    h.height = f.h;
+    h.bpp = f.c * f.d;
+    h.reserved = 0;
+    h.length = msg->size() - sizeof(h);
+    memcpy(msg->data(), &h, sizeof(h));
+
+    return msg;
+}
+
+void
+camgazebo_fanout_s::flush(client& c)
+{
+    while (!c.queue.empty())
+    {
+        const std::vector<uint8_t>& msg = *c.queue.front();
+        ssize_t n = send(c.fd, msg.data() + c.offset, msg.size() - c.offset, MSG_NOSIGNAL);
+        if (n == -1)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                c.closed = true;
+            return;
+        }
+
+        c.offset += n;
+        if (c.offset == msg.size())
+        {
+            c.queue.pop_front();
+            c.offset = 0;
+            sent++;
+        }
+    }
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#ifndef H_CAMGAZEBO_FANOUT
+#define H_CAMGAZEBO_FANOUT
+
+#include "camgazebo_c_types.h"
+
+#include "frame_view.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Local frame server over a Unix domain stream socket. Each client
+// negotiates its own rate and codec by sending a line of settings, at any
+// time:
+//
+//   rate=<Hz, 0 for every frame> codec=<raw|jpeg|png> quality=<0-100>\n
+//
+// and receives frames, each as a fanout_header followed by its payload.
+// Every client has its own send queue, which drops its oldest frames when
+// the client does not keep up. A frame is encoded once per distinct
+// (codec, quality) among the clients it is sent to. The main task only
+// hands the latest raw frame over; encoding and sending run in the server
+// thread.
+struct fanout_header {      // native endianness
+    char magic[4];          // "CGZF"
+    uint32_t codec;         // fanout_codec actually used
+    uint32_t seq;           // raw frame counter
+    int32_t sec;
+    int32_t nsec;
+    uint16_t width;
+    uint16_t height;
+    uint16_t bpp;
+    uint16_t reserved;
+    uint32_t length;        // payload bytes
+};
+
+enum fanout_codec { fanout_raw = 0, fanout_jpeg = 1, fanout_png = 2 };
+
+struct camgazebo_fanout_s {
+    static const size_t queue_depth = 4;
+
+    std::atomic<uint32_t> clients{0};
+    std::atomic<uint32_t> sent{0};
+    std::atomic<uint32_t> dropped{0};
+    std::atomic<uint32_t> encodes{0};
+
+    ~camgazebo_fanout_s() { stop(); }
+
+    bool start(const char* path);
+    void stop();
+    bool running() const { return server.joinable(); }
+
+    // hand the frame over to the server thread, replacing the previous one
+    // if it was not taken yet; no-op unless a client is due for a frame
+    void push(const frame_view& f, const or_time_ts& ts, uint32_t seq);
+
+  private:
+    typedef std::shared_ptr<const std::vector<uint8_t>> message;
+
+    struct frame {
+        std::vector<uint8_t> pixels;
+        uint16_t w, h, c, d;
+        or_time_ts ts;
+        uint32_t seq;
+    };
+
+    struct client {
+        int fd;
+        double period = 0;
+        fanout_codec codec = fanout_raw;
+        int quality = 90;
+        std::chrono::steady_clock::time_point next;
+        std::string line;
+        std::deque<message> queue;
+        size_t offset = 0;      // of the front message already sent
+        bool closed = false;
+    };
+
+    void run();
+    void negotiate(client& c);
+    void distribute(const frame& f);
+    message encode(const frame& f, fanout_codec codec, int quality);
+    void flush(client& c);
+
+    std::string path;
+    int listen_fd = -1;
+    int wake[2] = { -1, -1 };
+    std::atomic<bool> stopping{false};
+    std::thread server;
+    std::vector<client> conns;
+    // earliest next send among the clients, in steady clock ticks
+    std::atomic<int64_t> due{INT64_MAX};
+
+    std::mutex m;
+    frame pending, current;
+    bool has_pending = false;
+};
+
+#endif /* H_CAMGAZEBO_FANOUT */
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include "accamgazebo.h"
+
+#include "fiducial.hpp"
+
+#include <cmath>
+
+#ifdef HAVE_OPENCV2_ARUCO_HPP
+#include <opencv2/aruco.hpp>
+#endif
+
+
+/* --- Detection ---------------------------------------------------------- */
+
+#ifdef HAVE_OPENCV2_ARUCO_HPP
+// the enum type changed name across opencv versions, not its values
+static int
+dictionary(camgazebo_tag_family family)
+{
+    switch (family)
+    {
+        case camgazebo_tag_aruco_4x4_50:        return cv::aruco::DICT_4X4_50;
+        case camgazebo_tag_aruco_5x5_100:       return cv::aruco::DICT_5X5_100;
+        case camgazebo_tag_aruco_6x6_250:       return cv::aruco::DICT_6X6_250;
+        case camgazebo_tag_aruco_original:      return cv::aruco::DICT_ARUCO_ORIGINAL;
+        case camgazebo_tag_apriltag_16h5:       return cv::aruco::DICT_APRILTAG_16h5;
+        case camgazebo_tag_apriltag_25h9:       return cv::aruco::DICT_APRILTAG_25h9;
+        case camgazebo_tag_apriltag_36h10:      return cv::aruco::DICT_APRILTAG_36h10;
+        case camgazebo_tag_apriltag_36h11:      return cv::aruco::DICT_APRILTAG_36h11;
+    }
+    return cv::aruco::DICT_APRILTAG_36h11;
+}
+#endif
+
+bool
+camgazebo_fiducial_s::available()
+{
+#ifdef HAVE_OPENCV2_ARUCO_HPP
+    return true;
+#else
+    return false;
+#endif
+}
+
+// runs on the worker thread
+void
+camgazebo_fiducial_s::detect()
+{
+    ids.clear();
+    corners.clear();
+    rvecs.clear();
+    tvecs.clear();
+
+#ifdef HAVE_OPENCV2_ARUCO_HPP
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 7)
+    cv::aruco::ArucoDetector detector(cv::aruco::getPredefinedDictionary(dictionary(detect_family)));
+    detector.detectMarkers(gray, corners, ids);
+#else
+    cv::aruco::detectMarkers(gray, cv::aruco::getPredefinedDictionary(dictionary(detect_family)), corners, ids);
+#endif
+
+    // marker corners in its own frame, in the order of the detected ones
+    float s = detect_size / 2;
+    std::vector<cv::Point3f> square = {
+        cv::Point3f(-s, s, 0), cv::Point3f(s, s, 0), cv::Point3f(s, -s, 0), cv::Point3f(-s, -s, 0)
+    };
+
+    for (const std::vector<cv::Point2f>& c : corners)
+    {
+        cv::Vec3d r, t;
+
+        // fisheye outputs are undistorted first, the pose is then pinhole
+        if (model == camgazebo_proj_pinhole)
+            cv::solvePnP(square, c, K, D, r, t, false, cv::SOLVEPNP_IPPE_SQUARE);
+        else
+        {
+            std::vector<cv::Point2f> u;
+            cv::fisheye::undistortPoints(c, u, K, D, cv::noArray(), K);
+            cv::solvePnP(square, u, K, cv::noArray(), r, t, false, cv::SOLVEPNP_IPPE_SQUARE);
+        }
+        rvecs.push_back(r);
+        tvecs.push_back(t);
+    }
+#endif
+
+    done = true;
+}
+
+void
+camgazebo_fiducial_s::start(const frame_view& f, const or_sensor_intrinsics* intr,
+                            camgazebo_projection model, const float kb[4], or_time_ts ts)
+{
+    if (f.c == 1)
+        f.mat().copyTo(gray);
+    else
+        cv::cvtColor(f.mat(), gray, cv::COLOR_RGB2GRAY);
+
+    K = cv::Matx33d(intr->calib.fx, intr->calib.gamma, intr->calib.cx,
+                    0, intr->calib.fy, intr->calib.cy,
+                    0, 0, 1);
+    this->model = model;
+    if (model == camgazebo_proj_pinhole)
+        D = { intr->disto.k1, intr->disto.k2, intr->disto.p1, intr->disto.p2, intr->disto.k3 };
+    else if (model == camgazebo_proj_kannala_brandt)
+        D = { kb[0], kb[1], kb[2], kb[3] };
+    else
+        D = { 0, 0, 0, 0 };
+    detect_family = family;
+    detect_size = tag_size;
+    this->ts = ts;
+
+    if (!pool)
+        pool.reset(new worker_pool(1));
+
+    running = true;
+    done = false;
+    pool->submit([this]() { detect(); });
+}
+
+bool
+camgazebo_fiducial_s::fetch(camgazebo_tag_detections* out)
+{
+    uint32_t n = ids.size();
+
+    running = false;
+    if (n > out->tags._maximum)
+        if (genom_sequence_reserve(&(out->tags), n) == -1)
+            return false;
+    out->tags._length = n;
+    out->ts = ts;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        camgazebo_tag* tag = &out->tags._buffer[i];
+        tag->id = ids[i];
+        for (int k = 0; k < 4; k++)
+        {
+            tag->corners[2 * k] = corners[i][k].x;
+            tag->corners[2 * k + 1] = corners[i][k].y;
+        }
+
+        // same convention as the extrinsics port, R = Rz(yaw) Ry(pitch) Rx(roll)
+        cv::Matx33d R;
+        cv::Rodrigues(rvecs[i], R);
+        tag->pose[0] = tvecs[i][0];
+        tag->pose[1] = tvecs[i][1];
+        tag->pose[2] = tvecs[i][2];
+        tag->pose[3] = std::atan2(R(2, 1), R(2, 2));
+        tag->pose[4] = std::atan2(-R(2, 0), std::hypot(R(2, 1), R(2, 2)));
+        tag->pose[5] = std::atan2(R(1, 0), R(0, 0));
+    }
+
+    frames++;
+    detections += n;
+    return true;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#ifndef H_CAMGAZEBO_FIDUCIAL
+#define H_CAMGAZEBO_FIDUCIAL
+
+#include "camgazebo_c_types.h"
+
+#include "frame_view.hpp"
+#include "worker_pool.hpp"
+
+#include <opencv2/opencv.hpp>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Fiducial marker (ArUco and AprilTag families) detection on a worker
+// thread. The main task hands a grayscale copy of the raw frame over when
+// the worker is idle and publishes the result on a later frame, so
+// detection never delays the frame ports; frames arriving while the worker
+// is busy are not detected. Poses derive from the component intrinsics.
+struct camgazebo_fiducial_s {
+    bool enabled = false;
+    bool exclusive = false;     // only detections are published, not the raw port
+    camgazebo_tag_family family = camgazebo_tag_apriltag_36h11;
+    float tag_size = 0.1;       // side of the black square (m)
+
+    uint32_t frames = 0;        // detected
+    uint32_t detections = 0;
+    uint32_t skipped = 0;       // worker busy
+
+    // false if built without the opencv aruco module
+    static bool available();
+
+    bool busy() const { return running; }
+    bool ready() const { return running && done; }
+
+    // detect in f, 8 bits per channel, in the background; only called when
+    // not busy
+    void start(const frame_view& f, const or_sensor_intrinsics* intr,
+               camgazebo_projection model, const float kb[4], or_time_ts ts);
+    // fill out with the finished detection; false on allocation failure
+    bool fetch(camgazebo_tag_detections* out);
+
+  private:
+    void detect();
+
+    cv::Mat gray;
+    cv::Matx33d K;
+    std::vector<double> D;      // (k1,k2,p1,p2,k3) for pinhole, kb otherwise
+    camgazebo_projection model = camgazebo_proj_pinhole;
+    camgazebo_tag_family detect_family = camgazebo_tag_apriltag_36h11;
+    double detect_size = 0.1;
+    or_time_ts ts;
+
+    std::vector<int> ids;
+    std::vector<std::vector<cv::Point2f>> corners;
+    std::vector<cv::Vec3d> rvecs;
+    std::vector<cv::Vec3d> tvecs;
+
+    bool running = false;
+    std::atomic<bool> done{false};
+    std::unique_ptr<worker_pool> pool;  // declared last: joined before the buffers it uses are freed
+};
+
+#endif /* H_CAMGAZEBO_FIDUCIAL */
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include "accamgazebo.h"
+
+#include "frame_alloc.hpp"
+
+#include <err.h>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef HAVE_NUMAIF_H
+#include <numaif.h>
+#endif
+
+static const size_t huge_page = 2 << 20;
+
+static size_t
+round_up(size_t n, size_t a)
+{
+    return (n + a - 1) / a * a;
+}
+
+
+/* --- frame_memory ------------------------------------------------------- */
+
+bool
+frame_memory::allocate(size_t len)
+{
+    release();
+
+    size_t page = sysconf(_SC_PAGESIZE);
+    void* p = MAP_FAILED;
+
+    if (pages == camgazebo_pages_explicit)
+    {
+        mapped = round_up(len ? len : 1, huge_page);
+        p = mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p == MAP_FAILED)
+            warnx("no explicit huge pages available (vm.nr_hugepages), using transparent ones");
+        else
+            huge = true;
+    }
+
+    if (p == MAP_FAILED)
+    {
+        // transparent huge pages need 2MB aligned ranges, map one more and
+        // trim both ends
+        size_t align = pages == camgazebo_pages_default ? page : huge_page;
+        mapped = round_up(len ? len : 1, align);
+        p = mmap(NULL, mapped + align, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            return false;
+
+        uint8_t* base = (uint8_t*)p;
+        uint8_t* aligned = (uint8_t*)round_up((uintptr_t)base, align);
+        if (aligned > base)
+            munmap(base, aligned - base);
+        if (aligned < base + align)
+            munmap(aligned + mapped, base + align - aligned);
+        p = aligned;
+    }
+
+    ptr = (uint8_t*)p;
+    this->len = len;
+
+    frame_advise(ptr, mapped, huge ? camgazebo_pages_default : pages, node);
+
+    // fault the pages in now, from the thread that reads the frames, rather
+    // than in the transport callback
+    memset(ptr, 0, mapped);
+    return true;
+}
+
+void
+frame_memory::release()
+{
+    if (ptr)
+        munmap(ptr, mapped);
+    ptr = nullptr;
+    len = mapped = 0;
+    huge = false;
+}
+
+
+/* --- frame_advise ------------------------------------------------------- */
+
+bool
+frame_advise(void* p, size_t len, camgazebo_page_policy pages, int16_t node)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t begin = round_up((uintptr_t)p, page);
+    uintptr_t end = ((uintptr_t)p + len) / page * page;
+    bool ok = true;
+
+    if (end <= begin)
+        return true;
+
+    if (pages != camgazebo_pages_default
+        && madvise((void*)begin, end - begin, MADV_HUGEPAGE) == -1)
+    {
+        warn("madvise");
+        ok = false;
+    }
+
+    if (node >= 0)
+    {
+#ifdef HAVE_NUMAIF_H
+        unsigned long mask[4] = { 0 };
+        if (node >= (int16_t)(8 * sizeof(mask)))
+            return false;
+        mask[node / (8 * sizeof(*mask))] = 1UL << (node % (8 * sizeof(*mask)));
+
+        // pages already touched are migrated
+        if (mbind((void*)begin, end - begin, MPOL_PREFERRED, mask, 8 * sizeof(mask), MPOL_MF_MOVE) == -1)
+        {
+            warn("mbind");
+            ok = false;
+        }
+#else
+        warnx("built without libnuma, ignoring NUMA node %d", node);
+        ok = false;
+#endif
+    }
+
+    return ok;
+}
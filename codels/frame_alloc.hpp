@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#ifndef H_CAMGAZEBO_FRAME_ALLOC
+#define H_CAMGAZEBO_FRAME_ALLOC
+
+#include "camgazebo_c_types.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Page backing of large frame buffers. At 4K a frame spans thousands of
+// base pages: huge pages cut the TLB misses of full frame copies, and
+// binding to a NUMA node (or touching the pages from the thread that reads
+// them) keeps the copies on the local memory controller.
+struct frame_memory {
+    uint8_t* ptr = nullptr;
+    size_t len = 0;         // requested size
+    size_t mapped = 0;      // size of the mapping
+    bool huge = false;      // backed by explicit huge pages
+
+    camgazebo_page_policy pages = camgazebo_pages_default;
+    int16_t node = -1;      // NUMA node, -1 for first touch
+
+    ~frame_memory() { release(); }
+
+    // map len bytes with the current policy and touch them from the calling
+    // thread; the previous mapping is released
+    bool allocate(size_t len);
+    void release();
+};
+
+// Apply the policy to memory allocated elsewhere (port sequences), on the
+// pages fully contained in [p, p + len). Explicit huge pages cannot be
+// applied afterwards and fall back to transparent ones.
+bool frame_advise(void* p, size_t len, camgazebo_page_policy pages, int16_t node);
+
+#endif /* H_CAMGAZEBO_FRAME_ALLOC */
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#ifndef H_CAMGAZEBO_FRAME_VIEW
+#define H_CAMGAZEBO_FRAME_VIEW
+
+#include "camgazebo_c_types.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <cstdint>
+#include <cstring>
+
+// Non-owning view over an image buffer, with its geometry and the owner of
+// the memory it points to. Processing stages take and produce views, so
+// that the transport buffer, the port sequences and the scratch buffers
+// are never copied besides the single copy into the raw port.
+struct frame_view {
+    enum owner {
+        none,
+        transport,      // or_camera_data, valid while its mutex is held
+        port,           // port sequence, valid until the next reserve
+        scratch         // camgazebo_frames_s, reused across frames
+    };
+
+    uint8_t* data = nullptr;
+    uint16_t w = 0;
+    uint16_t h = 0;
+    uint16_t c = 1;     // channels
+    uint16_t d = 1;     // bytes per channel
+    size_t stride = 0;  // bytes per row
+    owner own = none;
+
+    frame_view() = default;
+    frame_view(uint8_t* data, uint16_t w, uint16_t h, uint16_t c, uint16_t d,
+               owner own, size_t stride = 0)
+        : data(data), w(w), h(h), c(c), d(d),
+          stride(stride ? stride : (size_t)w * c * d), own(own) {}
+
+    // view over a port frame whose pixels hold w * h * c * d bytes
+    static frame_view of(or_sensor_frame* f, uint16_t c, uint16_t d)
+    {
+        return frame_view(f->pixels._buffer, f->width, f->height, c, d, port);
+    }
+
+    uint16_t bpp() const { return c * d; }
+    size_t size() const { return stride * h; }
+    bool contiguous() const { return stride == (size_t)w * bpp(); }
+    bool same_format(const frame_view& o) const { return w == o.w && h == o.h && c == o.c && d == o.d; }
+
+    // labels and depth are 16 bits, everything else 8 bits per channel
+    int type() const { return CV_MAKETYPE(d == 1 ? CV_8U : CV_16U, c); }
+    cv::Mat mat() const { return cv::Mat(h, w, type(), data, stride); }
+
+    // copy into a view of the same format, in one go if both are contiguous;
+    // through the caches, as the copy is read right after
+    void copy_to(const frame_view& o) const
+    {
+        if (contiguous() && o.contiguous())
+            memcpy(o.data, data, size());
+        else
+            for (uint16_t y = 0; y < h; y++)
+                memcpy(o.data + y * o.stride, data + y * stride, (size_t)w * bpp());
+    }
+};
+
+#endif /* H_CAMGAZEBO_FRAME_VIEW */
@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include "accamgazebo.h"
+
+#include "label_codec.hpp"
+
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+
+static inline uint8_t*
+put_varint(uint8_t* o, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        *o++ = (v & 0x7f) | 0x80;
+        v >>= 7;
+    }
+    *o++ = v;
+    return o;
+}
+
+// NULL past end or on a varint longer than 64 bits
+static inline const uint8_t*
+get_varint(const uint8_t* i, const uint8_t* end, uint64_t& v)
+{
+    v = 0;
+    for (unsigned shift = 0; i < end && shift < 64; shift += 7)
+    {
+        uint8_t b = *i++;
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return i;
+    }
+    return NULL;
+}
+
+template <typename T>
+static inline T
+load(const uint8_t* p)
+{
+    T v;
+    memcpy(&v, p, sizeof(T));
+    return v;
+}
+
+// Labels are loaded as integers of the smallest type that holds them, so
+// that runs are detected with plain comparisons.
+template <unsigned bpp>
+using label_t = typename std::conditional<bpp == 1, uint8_t,
+                typename std::conditional<bpp == 2, uint16_t,
+                typename std::conditional<bpp <= 4, uint32_t, uint64_t>::type>::type>::type;
+
+// Palette of at most 256 labels, looked up once per run rather than per
+// pixel. One and two bytes labels index a flat table, reset entry by entry;
+// wider ones an open addressing table twice the palette size. Instances are
+// per thread and reused, so that encoding a frame does not allocate.
+template <typename T, bool flat = (sizeof(T) <= 2)>
+struct palette_index;
+
+template <typename T>
+struct palette_index<T, true> {
+    std::vector<T> labels;
+    uint16_t slot[1 << (8 * sizeof(T))];    // index + 1, 0 if absent
+
+    palette_index() { memset(slot, 0, sizeof(slot)); labels.reserve(256); }
+
+    uint16_t& find(T v) { return slot[v]; }
+
+    void clear()
+    {
+        for (T v : labels)
+            slot[v] = 0;
+        labels.clear();
+    }
+};
+
+template <typename T>
+struct palette_index<T, false> {
+    static const unsigned size = 512;
+    std::vector<T> labels;
+    T key[size];
+    uint16_t slot[size];
+
+    palette_index() { memset(slot, 0, sizeof(slot)); labels.reserve(256); }
+
+    uint16_t& find(T v)
+    {
+        unsigned h = (uint64_t)v * 0x9e3779b97f4a7c15ULL >> 55;
+        while (slot[h] && key[h] != v)
+            h = (h + 1) % size;
+        key[h] = v;
+        return slot[h];
+    }
+
+    void clear()
+    {
+        memset(slot, 0, sizeof(slot));
+        labels.clear();
+    }
+};
+
+template <unsigned bpp>
+size_t
+label_encode(label_codec_type codec, const uint8_t* src, size_t n, uint8_t* out)
+{
+    typedef label_t<bpp> T;
+    static thread_local palette_index<T> index;
+
+    uint8_t* o = out;
+    *o++ = codec;
+    *o++ = bpp;
+
+    // palette runs are written past room for the largest palette, which
+    // is only known at the end, and moved down next to it
+    uint8_t* palette = o;
+    if (codec == label_palette)
+        o += 2 + 256 * bpp;
+    uint8_t* runs = o;
+
+    size_t i = 0;
+    while (i < n)
+    {
+        T v = 0;
+        memcpy(&v, src + i * bpp, bpp);
+
+        size_t j = i + 1;
+        if (bpp == sizeof(T))
+            while (j < n && load<T>(src + j * bpp) == v)
+                j++;
+        else
+            while (j < n && !memcmp(src + j * bpp, src + i * bpp, bpp))
+                j++;
+
+        o = put_varint(o, j - i);
+        if (codec == label_palette)
+        {
+            uint16_t& k = index.find(v);
+            if (!k)
+            {
+                if (index.labels.size() == 256)
+                {
+                    index.clear();
+                    return 0;
+                }
+                index.labels.push_back(v);
+                k = index.labels.size();
+            }
+            *o++ = k - 1;
+        }
+        else
+        {
+            memcpy(o, &v, bpp);
+            o += bpp;
+        }
+        i = j;
+    }
+
+    if (codec == label_palette)
+    {
+        uint8_t* p = put_varint(palette, index.labels.size());
+        for (T v : index.labels)
+        {
+            memcpy(p, &v, bpp);
+            p += bpp;
+        }
+        memmove(p, runs, o - runs);
+        o = p + (o - runs);
+        index.clear();
+    }
+
+    return o - out;
+}
+
+template size_t label_encode<1>(label_codec_type, const uint8_t*, size_t, uint8_t*);
+template size_t label_encode<2>(label_codec_type, const uint8_t*, size_t, uint8_t*);
+template size_t label_encode<3>(label_codec_type, const uint8_t*, size_t, uint8_t*);
+template size_t label_encode<4>(label_codec_type, const uint8_t*, size_t, uint8_t*);
+template size_t label_encode<5>(label_codec_type, const uint8_t*, size_t, uint8_t*);
+template size_t label_encode<6>(label_codec_type, const uint8_t*, size_t, uint8_t*);
+template size_t label_encode<7>(label_codec_type, const uint8_t*, size_t, uint8_t*);
+template size_t label_encode<8>(label_codec_type, const uint8_t*, size_t, uint8_t*);
+
+size_t
+label_encode(label_codec_type codec, const uint8_t* src, size_t n, unsigned bpp, uint8_t* out)
+{
+    switch (bpp)
+    {
+        case 1: return label_encode<1>(codec, src, n, out);
+        case 2: return label_encode<2>(codec, src, n, out);
+        case 3: return label_encode<3>(codec, src, n, out);
+        case 4: return label_encode<4>(codec, src, n, out);
+        case 5: return label_encode<5>(codec, src, n, out);
+        case 6: return label_encode<6>(codec, src, n, out);
+        case 7: return label_encode<7>(codec, src, n, out);
+        default: return label_encode<8>(codec, src, n, out);
+    }
+}
+
+
+/* --- Decoder ------------------------------------------------------------ */
+
+size_t
+label_decode(const uint8_t* in, size_t len, uint8_t* dst, size_t n)
+{
+    const uint8_t* end = in + len;
+    if (len < 2 || (in[0] != label_rle && in[0] != label_palette) || in[1] < 1 || in[1] > 8)
+        return 0;
+    label_codec_type codec = (label_codec_type)in[0];
+    unsigned bpp = in[1];
+    in += 2;
+
+    uint64_t colors = 0;
+    const uint8_t* palette = in;
+    if (codec == label_palette)
+    {
+        in = get_varint(in, end, colors);
+        if (!in || colors > 256 || (uint64_t)(end - in) < colors * bpp)
+            return 0;
+        palette = in;
+        in += colors * bpp;
+    }
+
+    size_t i = 0;
+    while (in < end)
+    {
+        uint64_t count;
+        in = get_varint(in, end, count);
+        if (!in || count > n - i)
+            return 0;
+
+        const uint8_t* label = in;
+        if (codec == label_palette)
+        {
+            if (in == end || *in >= colors)
+                return 0;
+            label = palette + *in++ * bpp;
+        }
+        else
+        {
+            if ((size_t)(end - in) < bpp)
+                return 0;
+            in += bpp;
+        }
+
+        for (uint64_t k = 0; k < count; k++, i++)
+            memcpy(dst + i * bpp, label, bpp);
+    }
+    return i;
+}
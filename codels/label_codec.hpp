@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#ifndef H_CAMGAZEBO_LABEL_CODEC
+#define H_CAMGAZEBO_LABEL_CODEC
+
+#include <cstddef>
+#include <cstdint>
+
+// Lossless encodings of label images (segmentation cameras), published on
+// the "labels" frame instance. A pixel is a little-endian label of bpp
+// bytes (1 to 8) and the image is encoded as a single row-major stream.
+//
+//   byte 0         codec: 1 run-length, 2 palette
+//   byte 1         bpp
+//   rle            runs of { varint count, label (bpp bytes) }
+//   palette        varint N, N labels (bpp bytes each), then runs of
+//                  { varint count, palette index (1 byte) }
+//
+// Varints are LEB128 (7 bits per byte, low bits first). Palette encoding
+// requires at most 256 distinct labels.
+
+enum label_codec_type { label_rle = 1, label_palette = 2 };
+
+// Size of an output buffer large enough for any encoding of n pixels.
+inline size_t
+label_encode_bound(size_t n, unsigned bpp)
+{
+    return 2 + 10 + 256 * bpp + n * (1 + bpp);
+}
+
+// Encode n pixels into out, which must hold label_encode_bound(n, bpp)
+// bytes. Returns the encoded size, or 0 if the palette codec was requested
+// for an image with more than 256 labels.
+size_t label_encode(label_codec_type codec, const uint8_t* src, size_t n, unsigned bpp, uint8_t* out);
+
+// Same, for a pixel size known at compile time (instantiated for 1 to 8).
+template <unsigned bpp>
+size_t label_encode(label_codec_type codec, const uint8_t* src, size_t n, uint8_t* out);
+
+// Decode an encoding of len bytes into dst, which holds n pixels of the
+// bpp of the encoding. Returns the number of decoded pixels, or 0 if the
+// encoding is malformed or holds more than n pixels.
+size_t label_decode(const uint8_t* in, size_t len, uint8_t* dst, size_t n);
+
+#endif /* H_CAMGAZEBO_LABEL_CODEC */
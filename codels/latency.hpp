@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#ifndef H_CAMGAZEBO_LATENCY
+#define H_CAMGAZEBO_LATENCY
+
+#include "camgazebo_c_types.h"
+
+#include <chrono>
+#include <cstdint>
+
+// Frame to port latency against a budget. Each published frame reports the
+// duration of its stages; frames over budget are counted and the last ones
+// logged in a ring, with the stage that took the largest share.
+//   transport      gazebo callback, from message arrival to the frame being
+//                  copied (including waiting for the previous frame)
+//   handoff        from the copied frame to camgz_pub taking it
+//   raw write      copy into and write of the raw port
+//   encode         compressed, labels, log and export stages
+struct camgazebo_latency_s {
+    typedef std::chrono::steady_clock clock;
+
+    static constexpr uint32_t ring_size = 32;
+
+    double budget = 0;      // sec, 0 to disable
+    uint32_t frames = 0;
+    uint32_t violations = 0;
+    camgazebo_latency_violation ring[ring_size];
+
+    void record(const or_time_ts& ts, clock::time_point arrival, clock::time_point ready,
+                clock::time_point taken, clock::time_point written, clock::time_point encoded)
+    {
+        typedef std::chrono::duration<float, std::milli> ms;
+        float t[4] = {
+            ms(ready - arrival).count(),
+            ms(taken - ready).count(),
+            ms(written - taken).count(),
+            ms(encoded - written).count()
+        };
+        float total = ms(encoded - arrival).count();
+
+        frames++;
+        if (budget <= 0 || total <= budget * 1e3)
+            return;
+
+        camgazebo_latency_violation& v = ring[violations++ % ring_size];
+        uint32_t worst = 0;
+        for (uint32_t i = 1; i < 4; i++)
+            if (t[i] > t[worst])
+                worst = i;
+
+        v.ts = ts;
+        v.stage = (camgazebo_latency_stage)worst;
+        v.total_ms = total;
+        v.transport_ms = t[0];
+        v.handoff_ms = t[1];
+        v.raw_write_ms = t[2];
+        v.encode_ms = t[3];
+    }
+};
+
+#endif /* H_CAMGAZEBO_LATENCY */
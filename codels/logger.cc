@@ -0,0 +1,337 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include "accamgazebo.h"
+
+#include "logger.hpp"
+
+#include <cmath>
+#include <cstring>
+
+
+/* --- ROS1 message definitions ------------------------------------------- */
+
+static const char sep[] =
+    "================================================================================\n";
+
+static const char header_def[] =
+    "MSG: std_msgs/Header\n"
+    "uint32 seq\n"
+    "time stamp\n"
+    "string frame_id\n";
+
+static std::string image_def()
+{
+    return std::string(
+        "std_msgs/Header header\n"
+        "uint32 height\n"
+        "uint32 width\n"
+        "string encoding\n"
+        "uint8 is_bigendian\n"
+        "uint32 step\n"
+        "uint8[] data\n") + sep + header_def;
+}
+
+static std::string compressed_def()
+{
+    return std::string(
+        "std_msgs/Header header\n"
+        "string format\n"
+        "uint8[] data\n") + sep + header_def;
+}
+
+static std::string camera_info_def()
+{
+    return std::string(
+        "std_msgs/Header header\n"
+        "uint32 height\n"
+        "uint32 width\n"
+        "string distortion_model\n"
+        "float64[] D\n"
+        "float64[9] K\n"
+        "float64[9] R\n"
+        "float64[12] P\n"
+        "uint32 binning_x\n"
+        "uint32 binning_y\n"
+        "sensor_msgs/RegionOfInterest roi\n") + sep + header_def + sep +
+        "MSG: sensor_msgs/RegionOfInterest\n"
+        "uint32 x_offset\n"
+        "uint32 y_offset\n"
+        "uint32 height\n"
+        "uint32 width\n"
+        "bool do_rectify\n";
+}
+
+static std::string transform_def()
+{
+    return std::string(
+        "std_msgs/Header header\n"
+        "string child_frame_id\n"
+        "geometry_msgs/Transform transform\n") + sep + header_def + sep +
+        "MSG: geometry_msgs/Transform\n"
+        "geometry_msgs/Vector3 translation\n"
+        "geometry_msgs/Quaternion rotation\n" + sep +
+        "MSG: geometry_msgs/Vector3\n"
+        "float64 x\n"
+        "float64 y\n"
+        "float64 z\n" + sep +
+        "MSG: geometry_msgs/Quaternion\n"
+        "float64 x\n"
+        "float64 y\n"
+        "float64 z\n"
+        "float64 w\n";
+}
+
+
+/* --- ROS1 serialization ------------------------------------------------- */
+
+template <typename T>
+static void
+put(std::vector<uint8_t>& b, T v)
+{
+    const uint8_t* p = (const uint8_t*)&v;    // ros1 is little-endian, as are our hosts
+    b.insert(b.end(), p, p + sizeof(T));
+}
+
+static void
+put_str(std::vector<uint8_t>& b, const char* s)
+{
+    uint32_t n = strlen(s);
+    put(b, n);
+    b.insert(b.end(), s, s + n);
+}
+
+static void
+put_header(std::vector<uint8_t>& b, uint32_t seq, or_time_ts ts, const char* frame_id)
+{
+    put(b, seq);
+    put<uint32_t>(b, ts.sec);
+    put<uint32_t>(b, ts.nsec);
+    put_str(b, frame_id);
+}
+
+static uint64_t
+nanoseconds(or_time_ts ts)
+{
+    return (uint64_t)ts.sec * 1000000000 + ts.nsec;
+}
+
+
+/* --- Control ------------------------------------------------------------ */
+
+bool
+camgazebo_logger_s::start(const char* path, mcap_writer::compression c)
+{
+    stop();
+
+    if (!mcap.open(path, c, "ros1"))
+        return false;
+
+    ch_raw = mcap.add_channel(mcap.add_schema("sensor_msgs/Image", "ros1msg", image_def()),
+                              "/camgazebo/raw", "ros1");
+    ch_compressed = mcap.add_channel(mcap.add_schema("sensor_msgs/CompressedImage", "ros1msg", compressed_def()),
+                                     "/camgazebo/compressed", "ros1");
+    ch_info = mcap.add_channel(mcap.add_schema("sensor_msgs/CameraInfo", "ros1msg", camera_info_def()),
+                               "/camgazebo/camera_info", "ros1");
+    ch_extrinsics = mcap.add_channel(mcap.add_schema("geometry_msgs/TransformStamped", "ros1msg", transform_def()),
+                                     "/camgazebo/extrinsics", "ros1");
+
+    seq = 0;
+    last_ext.clear();
+    messages = 0;
+    dropped = 0;
+    bytes = 0;
+    queue.clear();
+
+    running = true;
+    writer = std::thread(&camgazebo_logger_s::run, this);
+    return true;
+}
+
+// Stop logging, and return once everything queued is in the file.
+void
+camgazebo_logger_s::stop()
+{
+    if (!writer.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard(m);
+        running = false;
+    }
+    cv.notify_all();
+    writer.join();
+    mcap.close();
+    bytes = mcap.size();
+}
+
+
+/* --- Producer ----------------------------------------------------------- */
+
+camgazebo_logger_s::record*
+camgazebo_logger_s::claim()
+{
+    record* r = queue.claim();
+    if (!r)
+        dropped++;
+    else
+        r->msg.clear();     // keeps its capacity
+    return r;
+}
+
+void
+camgazebo_logger_s::commit()
+{
+    queue.commit();
+    { std::lock_guard<std::mutex> guard(m); }
+    cv.notify_one();
+}
+
+void
+camgazebo_logger_s::push_frame(const or_sensor_frame* f, bool is_compressed, const uint8_t* data, size_t len)
+{
+    record* r = claim();
+    if (!r)
+        return;
+
+    put_header(r->msg, seq++, f->ts, "camgazebo");
+    if (is_compressed)
+    {
+        r->channel = ch_compressed;
+        put_str(r->msg, "jpeg");
+    }
+    else
+    {
+        static const char* encodings[] = { "mono8", "mono16", "rgb8", "rgba8", "bgr8", "rgb16" };
+        const char* encoding = encodings[f->bpp == 2 ? 1 : f->bpp == 3 ? 2 : f->bpp == 4 ? 3 : f->bpp == 6 ? 5 : 0];
+
+        r->channel = ch_raw;
+        put<uint32_t>(r->msg, f->height);
+        put<uint32_t>(r->msg, f->width);
+        put_str(r->msg, encoding);
+        put<uint8_t>(r->msg, 0);
+        put<uint32_t>(r->msg, f->width * f->bpp);
+    }
+    put<uint32_t>(r->msg, len);
+    r->msg.insert(r->msg.end(), data, data + len);
+    r->t = nanoseconds(f->ts);
+
+    commit();
+}
+
+// Camera info goes with every frame, extrinsics only when they change.
+// Fisheye outputs use the ros equidistant model, whose four coefficients
+// are the Kannala-Brandt ones.
+void
+camgazebo_logger_s::push_calib(const or_sensor_frame* f, const or_sensor_intrinsics* intr,
+                               const or_sensor_extrinsics* ext, camgazebo_projection model,
+                               const float kb[4])
+{
+    record* r = claim();
+    if (!r)
+        return;
+
+    const or_sensor_calibration& c = intr->calib;
+    put_header(r->msg, seq, f->ts, "camgazebo");
+    put<uint32_t>(r->msg, f->height);
+    put<uint32_t>(r->msg, f->width);
+    if (model == camgazebo_proj_pinhole)
+    {
+        put_str(r->msg, "plumb_bob");
+        put<uint32_t>(r->msg, 5);
+        for (double d : { intr->disto.k1, intr->disto.k2, intr->disto.p1, intr->disto.p2, intr->disto.k3 })
+            put(r->msg, d);
+    }
+    else
+    {
+        put_str(r->msg, "equidistant");
+        put<uint32_t>(r->msg, 4);
+        for (int i = 0; i < 4; i++)
+            put<double>(r->msg, model == camgazebo_proj_kannala_brandt ? kb[i] : 0);
+    }
+    for (double k : { c.fx, c.gamma, c.cx, 0.f, c.fy, c.cy, 0.f, 0.f, 1.f })
+        put(r->msg, k);
+    for (double k : { 1, 0, 0, 0, 1, 0, 0, 0, 1 })
+        put(r->msg, k);
+    for (double k : { c.fx, c.gamma, c.cx, 0.f, 0.f, c.fy, c.cy, 0.f, 0.f, 0.f, 1.f, 0.f })
+        put(r->msg, k);
+    put<uint32_t>(r->msg, 0);
+    put<uint32_t>(r->msg, 0);
+    for (int i = 0; i < 4; i++)
+        put<uint32_t>(r->msg, 0);
+    put<uint8_t>(r->msg, 0);
+    r->channel = ch_info;
+    r->t = nanoseconds(f->ts);
+    commit();
+
+    std::vector<float> e = {
+        ext->trans.tx, ext->trans.ty, ext->trans.tz, ext->rot.roll, ext->rot.pitch, ext->rot.yaw
+    };
+    if (e == last_ext || !(r = claim()))
+        return;
+    last_ext = e;
+
+    double cr = cos(e[3] / 2), sr = sin(e[3] / 2);
+    double cp = cos(e[4] / 2), sp = sin(e[4] / 2);
+    double cy = cos(e[5] / 2), sy = sin(e[5] / 2);
+
+    put_header(r->msg, seq, f->ts, "base");
+    put_str(r->msg, "camgazebo");
+    for (double v : { (double)e[0], (double)e[1], (double)e[2],
+                      sr * cp * cy - cr * sp * sy,
+                      cr * sp * cy + sr * cp * sy,
+                      cr * cp * sy - sr * sp * cy,
+                      cr * cp * cy + sr * sp * sy })
+        put(r->msg, v);
+    r->channel = ch_extrinsics;
+    r->t = nanoseconds(f->ts);
+    commit();
+}
+
+
+/* --- Writer thread ------------------------------------------------------ */
+
+void
+camgazebo_logger_s::run()
+{
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock, [this] { return !running || queue.size() > 0; });
+        }
+
+        record* r = queue.front();
+        if (!r)
+        {
+            if (!running)
+                break;
+            continue;
+        }
+
+        mcap.write(r->channel, r->t, r->t, r->msg.data(), r->msg.size());
+        messages++;
+        bytes = mcap.size();
+        queue.pop();
+    }
+}
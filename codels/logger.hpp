@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#ifndef H_CAMGAZEBO_LOGGER
+#define H_CAMGAZEBO_LOGGER
+
+#include "camgazebo_c_types.h"
+
+#include "mcap_writer.hpp"
+#include "spsc_queue.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Streaming MCAP log of the published frames and calibration, with ROS1
+// message encoding (sensor_msgs/Image, sensor_msgs/CompressedImage,
+// sensor_msgs/CameraInfo and geometry_msgs/TransformStamped). The main task
+// serializes messages into a bounded lock-free queue, a writer thread
+// chunks, compresses and stores them.
+struct camgazebo_logger_s {
+    struct record {
+        uint16_t channel;
+        uint64_t t;
+        std::vector<uint8_t> msg;
+    };
+
+    bool raw = true;
+    bool compressed = false;
+
+    std::atomic<bool> running{false};
+    std::atomic<uint32_t> messages{0};
+    std::atomic<uint32_t> dropped{0};
+    std::atomic<uint64_t> bytes{0};
+
+    ~camgazebo_logger_s() { stop(); }
+
+    bool start(const char* path, mcap_writer::compression c);
+    void stop();
+
+    void push_frame(const or_sensor_frame* f, bool is_compressed, const uint8_t* data, size_t len);
+    void push_calib(const or_sensor_frame* f, const or_sensor_intrinsics* intr,
+                    const or_sensor_extrinsics* ext, camgazebo_projection model,
+                    const float kb[4]);
+
+  private:
+    void run();
+    record* claim();
+    void commit();
+
+    mcap_writer mcap;
+    uint16_t ch_raw, ch_compressed, ch_info, ch_extrinsics;
+    uint32_t seq = 0;
+    std::vector<float> last_ext;
+
+    spsc_queue<record, 64> queue;
+    std::thread writer;
+    std::mutex m;
+    std::condition_variable cv;
+};
+
+#endif /* H_CAMGAZEBO_LOGGER */
@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include "accamgazebo.h"
+
+#include "mcap_writer.hpp"
+
+#include <cstring>
+
+#ifdef HAVE_ZSTD_H
+#include <zstd.h>
+#endif
+#ifdef HAVE_LZ4FRAME_H
+#include <lz4frame.h>
+#endif
+
+static const uint8_t magic[8] = { 0x89, 'M', 'C', 'A', 'P', 0x30, '\r', '\n' };
+
+enum {
+    op_header = 0x01, op_footer = 0x02, op_schema = 0x03, op_channel = 0x04,
+    op_message = 0x05, op_chunk = 0x06, op_chunk_index = 0x08,
+    op_statistics = 0x0b, op_data_end = 0x0f
+};
+
+
+/* --- Little-endian serialization ---------------------------------------- */
+
+template <typename T>
+static void
+le(std::vector<uint8_t>& b, T v)
+{
+    for (size_t i = 0; i < sizeof(T); i++)
+        b.push_back((uint64_t)v >> (8 * i));
+}
+
+static void
+str(std::vector<uint8_t>& b, const char* s)
+{
+    uint32_t n = strlen(s);
+    le(b, n);
+    b.insert(b.end(), s, s + n);
+}
+
+static void
+record_to(std::vector<uint8_t>& b, uint8_t op, const std::vector<uint8_t>& body)
+{
+    b.push_back(op);
+    le<uint64_t>(b, body.size());
+    b.insert(b.end(), body.begin(), body.end());
+}
+
+
+/* --- Writer ------------------------------------------------------------- */
+
+bool
+mcap_writer::supports(compression c)
+{
+    switch (c)
+    {
+#ifdef HAVE_ZSTD_H
+        case zstd: return true;
+#endif
+#ifdef HAVE_LZ4FRAME_H
+        case lz4: return true;
+#endif
+        case none: return true;
+        default: return false;
+    }
+}
+
+bool
+mcap_writer::open(const char* path, compression c, const char* profile)
+{
+    f = fopen(path, "wb");
+    if (!f)
+        return false;
+    setvbuf(f, NULL, _IOFBF, 1 << 20);
+
+    offset = 0;
+    comp = c;
+    schemas.clear();
+    channels.clear();
+    nschemas = nchannels = 0;
+    chunk.clear();
+    index.clear();
+    messages = first = last = 0;
+    per_channel.clear();
+    sequence.clear();
+
+    put(magic, sizeof(magic));
+
+    std::vector<uint8_t> b;
+    str(b, profile);
+    str(b, "camgazebo");
+    record(op_header, b);
+    return true;
+}
+
+uint16_t
+mcap_writer::add_schema(const char* name, const char* encoding, const std::string& data)
+{
+    uint16_t id = ++nschemas;   // 0 is reserved
+    std::vector<uint8_t> b;
+    le(b, id);
+    str(b, name);
+    str(b, encoding);
+    le<uint32_t>(b, data.size());
+    b.insert(b.end(), data.begin(), data.end());
+
+    record(op_schema, b);
+    record_to(schemas, op_schema, b);
+    return id;
+}
+
+uint16_t
+mcap_writer::add_channel(uint16_t schema, const char* topic, const char* encoding)
+{
+    uint16_t id = nchannels++;
+    std::vector<uint8_t> b;
+    le(b, id);
+    le(b, schema);
+    str(b, topic);
+    str(b, encoding);
+    le<uint32_t>(b, 0);         // no metadata
+
+    record(op_channel, b);
+    record_to(channels, op_channel, b);
+    return id;
+}
+
+void
+mcap_writer::write(uint16_t channel, uint64_t log_time, uint64_t publish_time,
+                   const uint8_t* data, size_t len)
+{
+    if (chunk.empty())
+        chunk_start = chunk_end = log_time;
+    chunk_start = std::min(chunk_start, log_time);
+    chunk_end = std::max(chunk_end, log_time);
+
+    if (!messages || log_time < first)
+        first = log_time;
+    if (log_time > last)
+        last = log_time;
+    messages++;
+    per_channel[channel]++;
+
+    // the payload is appended in place to avoid a copy of large frames
+    chunk.push_back(op_message);
+    le<uint64_t>(chunk, 2 + 4 + 8 + 8 + len);
+    le(chunk, channel);
+    le(chunk, sequence[channel]++);
+    le(chunk, log_time);
+    le(chunk, publish_time);
+    chunk.insert(chunk.end(), data, data + len);
+
+    if (chunk.size() >= chunk_target)
+        flush_chunk();
+}
+
+void
+mcap_writer::flush_chunk()
+{
+    if (chunk.empty())
+        return;
+
+    const char* name = "";
+    const uint8_t* records = chunk.data();
+    size_t len = chunk.size();
+
+#ifdef HAVE_ZSTD_H
+    if (comp == zstd)
+    {
+        compressed.resize(ZSTD_compressBound(chunk.size()));
+        size_t n = ZSTD_compress(compressed.data(), compressed.size(), chunk.data(), chunk.size(), 1);
+        if (!ZSTD_isError(n))
+        {
+            name = "zstd";
+            records = compressed.data();
+            len = n;
+        }
+    }
+#endif
+#ifdef HAVE_LZ4FRAME_H
+    if (comp == lz4)
+    {
+        compressed.resize(LZ4F_compressFrameBound(chunk.size(), NULL));
+        size_t n = LZ4F_compressFrame(compressed.data(), compressed.size(), chunk.data(), chunk.size(), NULL);
+        if (!LZ4F_isError(n))
+        {
+            name = "lz4";
+            records = compressed.data();
+            len = n;
+        }
+    }
+#endif
+
+    std::vector<uint8_t> b;
+    le(b, chunk_start);
+    le(b, chunk_end);
+    le<uint64_t>(b, chunk.size());
+    le<uint32_t>(b, 0);         // crc not computed
+    str(b, name);
+    le<uint64_t>(b, len);
+
+    chunk_index ci = { chunk_start, chunk_end, offset, 1 + 8 + b.size() + len, len, chunk.size(), name };
+    index.push_back(ci);
+
+    uint8_t op = op_chunk;
+    uint64_t l = b.size() + len;
+    put(&op, 1);
+    std::vector<uint8_t> lb;
+    le(lb, l);
+    put(lb.data(), lb.size());
+    put(b.data(), b.size());
+    put(records, len);
+
+    chunk.clear();
+}
+
+bool
+mcap_writer::close()
+{
+    if (!f)
+        return false;
+
+    flush_chunk();
+
+    std::vector<uint8_t> b;
+    le<uint32_t>(b, 0);
+    record(op_data_end, b);
+
+    uint64_t summary_start = offset;
+    put(schemas.data(), schemas.size());
+    put(channels.data(), channels.size());
+
+    b.clear();
+    le(b, messages);
+    le(b, nschemas);
+    le<uint32_t>(b, nchannels);
+    le<uint32_t>(b, 0);         // attachments
+    le<uint32_t>(b, 0);         // metadata
+    le<uint32_t>(b, index.size());
+    le(b, first);
+    le(b, last);
+    le<uint32_t>(b, per_channel.size() * 10);
+    for (auto& c : per_channel)
+    {
+        le(b, c.first);
+        le(b, c.second);
+    }
+    record(op_statistics, b);
+
+    for (chunk_index& ci : index)
+    {
+        b.clear();
+        le(b, ci.start);
+        le(b, ci.end);
+        le(b, ci.offset);
+        le(b, ci.length);
+        le<uint32_t>(b, 0);     // no message indexes
+        le<uint64_t>(b, 0);
+        str(b, ci.compression);
+        le(b, ci.compressed_size);
+        le(b, ci.uncompressed_size);
+        record(op_chunk_index, b);
+    }
+
+    b.clear();
+    le(b, summary_start);
+    le<uint64_t>(b, 0);         // no summary offsets
+    le<uint32_t>(b, 0);
+    record(op_footer, b);
+    put(magic, sizeof(magic));
+
+    bool ok = !ferror(f);
+    ok = fclose(f) == 0 && ok;
+    f = NULL;
+    return ok;
+}
+
+void
+mcap_writer::put(const void* p, size_t n)
+{
+    fwrite(p, 1, n, f);
+    offset += n;
+}
+
+void
+mcap_writer::record(uint8_t op, const std::vector<uint8_t>& body)
+{
+    std::vector<uint8_t> b;
+    record_to(b, op, body);
+    put(b.data(), b.size());
+}
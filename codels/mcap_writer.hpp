@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#ifndef H_CAMGAZEBO_MCAP_WRITER
+#define H_CAMGAZEBO_MCAP_WRITER
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+// Minimal MCAP (https://mcap.dev) writer: messages are grouped in chunks,
+// optionally compressed with zstd or lz4 when the library was found at
+// configure time, and the file ends with a summary section (schemas,
+// channels, statistics and chunk indexes) so that readers can seek. CRCs
+// are left to zero, which disables their validation.
+class mcap_writer {
+  public:
+    enum compression { none, zstd, lz4 };
+
+    static bool supports(compression c);
+
+    bool open(const char* path, compression c, const char* profile);
+    bool is_open() const { return f != NULL; }
+    uint16_t add_schema(const char* name, const char* encoding, const std::string& data);
+    uint16_t add_channel(uint16_t schema, const char* topic, const char* encoding);
+
+    // data is the serialized message, times are in nanoseconds
+    void write(uint16_t channel, uint64_t log_time, uint64_t publish_time,
+               const uint8_t* data, size_t len);
+    bool close();
+
+    uint64_t size() const { return offset; }
+
+  private:
+    struct chunk_index {
+        uint64_t start, end, offset, length, compressed_size, uncompressed_size;
+        const char* compression;
+    };
+
+    void flush_chunk();
+    void put(const void* p, size_t n);
+    void record(uint8_t op, const std::vector<uint8_t>& body);
+
+    FILE* f = NULL;
+    uint64_t offset = 0;
+    compression comp = none;
+    size_t chunk_target = 4 << 20;
+
+    std::vector<uint8_t> schemas;       // serialized records, repeated in the summary
+    std::vector<uint8_t> channels;
+    uint16_t nschemas = 0;
+    uint16_t nchannels = 0;
+
+    std::vector<uint8_t> chunk;
+    uint64_t chunk_start = 0, chunk_end = 0;
+    std::vector<uint8_t> compressed;
+    std::vector<chunk_index> index;
+
+    uint64_t messages = 0;
+    uint64_t first = 0, last = 0;
+    std::map<uint16_t, uint64_t> per_channel;
+    std::map<uint16_t, uint32_t> sequence;
+};
+
+#endif /* H_CAMGAZEBO_MCAP_WRITER */
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include "accamgazebo.h"
+
+#include "dispatch.hpp"
+#include "motion.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+
+/* --- Sum of absolute differences kernels -------------------------------- */
+
+uint64_t
+sad_scalar(const uint8_t* a, const uint8_t* b, size_t n)
+{
+    uint64_t s = 0;
+    for (size_t i = 0; i < n; i++)
+        s += std::abs(a[i] - b[i]);
+    return s;
+}
+
+#if defined(__x86_64__)
+uint64_t
+sad_sse2(const uint8_t* a, const uint8_t* b, size_t n)
+{
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(a + i)),
+                                              _mm_loadu_si128((const __m128i*)(b + i))));
+
+    uint64_t s[2];
+    _mm_storeu_si128((__m128i*)s, acc);
+    return s[0] + s[1] + sad_scalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2"))) uint64_t
+sad_avx2(const uint8_t* a, const uint8_t* b, size_t n)
+{
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i*)(a + i)),
+                                                    _mm256_loadu_si256((const __m256i*)(b + i))));
+
+    uint64_t s[4];
+    _mm256_storeu_si256((__m256i*)s, acc);
+    return s[0] + s[1] + s[2] + s[3] + sad_scalar(a + i, b + i, n - i);
+}
+#endif
+
+#if defined(__ARM_NEON)
+uint64_t
+sad_neon(const uint8_t* a, const uint8_t* b, size_t n)
+{
+    uint64x2_t acc = vdupq_n_u64(0);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        uint16x8_t d = vpaddlq_u8(vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+        acc = vaddq_u64(acc, vpaddlq_u32(vpaddlq_u16(d)));
+    }
+    return vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1) + sad_scalar(a + i, b + i, n - i);
+}
+#endif
+
+
+/* --- camgazebo_motion_s ------------------------------------------------- */
+
+bool
+camgazebo_motion_s::changed(const frame_view& f)
+{
+    auto now = std::chrono::steady_clock::now();
+    size_t row = (size_t)f.w * f.bpp();
+    size_t rows = (f.h + step - 1) / step;
+    bool publish;
+
+    if (f.w != ref_w || f.h != ref_h || f.bpp() != ref_bpp)
+    {
+        ref.resize(rows * row);
+        ref_w = f.w;
+        ref_h = f.h;
+        ref_bpp = f.bpp();
+        publish = true;
+    }
+    else if (keepalive > 0 && now - last >= std::chrono::duration<double>(keepalive))
+        publish = true;
+    else
+    {
+        uint64_t s = 0;
+        for (size_t r = 0; r < rows; r++)
+            s += kernels.sad(f.data + r * step * f.stride, ref.data() + r * row, row);
+        publish = s > threshold * rows * row;
+    }
+
+    if (!publish)
+    {
+        skipped++;
+        return false;
+    }
+
+    for (size_t r = 0; r < rows; r++)
+        memcpy(ref.data() + r * row, f.data + r * step * f.stride, row);
+    last = now;
+    published++;
+    return true;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#ifndef H_CAMGAZEBO_MOTION
+#define H_CAMGAZEBO_MOTION
+
+#include "frame_view.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Motion triggered publishing: a frame is published if it differs enough
+// from the last published one, or if the keep-alive period has elapsed.
+// The difference is the mean absolute difference of the bytes of one row
+// out of step, which is cheap enough to run on every frame before it is
+// copied.
+struct camgazebo_motion_s {
+    static const uint16_t step = 4;
+
+    bool enabled = false;
+    float threshold = 2;        // mean absolute difference, per byte
+    double keepalive = 1;       // sec, 0 for none
+
+    uint32_t published = 0;
+    uint32_t skipped = 0;
+
+    // true if f must be published, in which case it becomes the reference
+    bool changed(const frame_view& f);
+
+    // drop the reference, the next frame is published
+    void reset()
+    {
+        ref.clear();
+        ref_w = ref_h = ref_bpp = 0;
+        last = std::chrono::steady_clock::time_point();
+    }
+
+  private:
+    std::vector<uint8_t> ref;   // sampled rows of the last published frame
+    uint16_t ref_w = 0, ref_h = 0, ref_bpp = 0;
+    std::chrono::steady_clock::time_point last;
+};
+
+#endif /* H_CAMGAZEBO_MOTION */
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#ifndef H_CAMGAZEBO_PIPELINE
+#define H_CAMGAZEBO_PIPELINE
+
+#include "frame_view.hpp"
+#include "label_codec.hpp"
+#include "resample.hpp"
+
+#include <opencv2/opencv.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Publication stages that depend on the pixel format. set_format
+// instantiates the pipeline of its channels and depth once, so that
+// camgz_pub selects the format with a single virtual call per stage and the
+// inner loops are compiled for a fixed pixel layout.
+struct pixel_pipeline {
+    uint16_t c;             // channels
+    uint16_t d;             // bytes per channel
+    const char* export_ext; // dataset export format
+    bool jpeg;              // compressed port available
+
+    virtual ~pixel_pipeline() {}
+
+    // resample src into dst through the reprojection maps
+    virtual void reproject(const frame_view& src, const frame_view& dst,
+                           const cv::Mat& map1, const cv::Mat& map2) const = 0;
+
+    // downsample src into dst with the tables of r, see resample.hpp
+    virtual void resample(area_resampler& r, const frame_view& src, const frame_view& dst) const = 0;
+
+    // pack n pixels as 0x00rrggbb, 8 bits per channel
+    virtual void pack_rgb(const uint8_t* src, size_t n, uint32_t* out) const = 0;
+
+    // label image encoding, see label_codec.hpp
+    virtual size_t encode_labels(label_codec_type codec, const uint8_t* src,
+                                 size_t n, uint8_t* out) const = 0;
+};
+
+template <uint16_t C, uint16_t D>
+struct pixel_pipeline_t : pixel_pipeline {
+    static_assert(C == 1 || C == 3, "1 or 3 channels");
+    static_assert(D == 1 || D == 2, "8 or 16 bits per channel");
+
+    pixel_pipeline_t()
+    {
+        c = C;
+        d = D;
+        // jpeg only handles 8 bits images
+        export_ext = D == 1 ? ".jpg" : ".png";
+        jpeg = D == 1;
+    }
+
+    void reproject(const frame_view& src, const frame_view& dst,
+                   const cv::Mat& map1, const cv::Mat& map2) const override
+    {
+        // 16 bits images are labels, which must not be interpolated
+        cv::remap(src.mat(), dst.mat(), map1, map2, D == 1 ? cv::INTER_LINEAR : cv::INTER_NEAREST);
+    }
+
+    void resample(area_resampler& r, const frame_view& src, const frame_view& dst) const override
+    {
+        // 16 bits images are labels, which must not be averaged
+        if (D == 1)
+            area_resample<C>(r, src, dst);
+        else
+            nearest_resample<C * D>(r, src, dst);
+    }
+
+    void pack_rgb(const uint8_t* src, size_t n, uint32_t* out) const override
+    {
+        // most significant byte of 16 bits little-endian channels
+        const size_t o = D - 1;
+        for (size_t i = 0; i < n; i++)
+        {
+            const uint8_t* p = src + i * C * D + o;
+            if (C == 1)
+                out[i] = p[0] << 16 | p[0] << 8 | p[0];
+            else
+                out[i] = p[0] << 16 | p[D] << 8 | p[2 * D];
+        }
+    }
+
+    size_t encode_labels(label_codec_type codec, const uint8_t* src,
+                         size_t n, uint8_t* out) const override
+    {
+        return label_encode<C * D>(codec, src, n, out);
+    }
+};
+
+// Pipeline for c channels of d bytes, nullptr for unsupported formats.
+pixel_pipeline* make_pixel_pipeline(uint16_t c, uint16_t d);
+
+// Buffers of the publication stages, kept across frames so that steady
+// state publishing does not allocate.
+struct camgazebo_frames_s {
+    std::unique_ptr<pixel_pipeline> pipeline;
+    std::vector<uint8_t> encoded;       // compressed or exported image
+    std::vector<int32_t> jpeg_params;
+    area_resampler resampler;           // rendered to published size
+    uint32_t seq = 0;                   // raw frames
+
+    // transport to raw port copies
+    uint32_t copies = 0;
+    double copy_bytes = 0;
+    double copy_sec = 0;
+};
+
+#endif /* H_CAMGAZEBO_PIPELINE */
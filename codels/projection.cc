@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include "accamgazebo.h"
+
+#include "projection.hpp"
+
+#include <cmath>
+
+
+float
+lens_radius(const lens& l, float theta)
+{
+    switch (l.model)
+    {
+        case camgazebo_proj_equidistant:
+            return theta;
+
+        case camgazebo_proj_kannala_brandt:
+        {
+            float t2 = theta * theta;
+            return theta * (1 + t2 * (l.k[0] + t2 * (l.k[1] + t2 * (l.k[2] + t2 * l.k[3]))));
+        }
+
+        default:
+            return tan(theta);
+    }
+}
+
+float
+lens_theta(const lens& l, float r)
+{
+    switch (l.model)
+    {
+        case camgazebo_proj_equidistant:
+            return r;
+
+        case camgazebo_proj_kannala_brandt:
+        {
+            // Newton iterations on theta_d(theta) = r, starting from the
+            // equidistant solution
+            float theta = r;
+            for (int i = 0; i < 10; i++)
+            {
+                float t2 = theta * theta;
+                float fx = theta * (1 + t2 * (l.k[0] + t2 * (l.k[1] + t2 * (l.k[2] + t2 * l.k[3])))) - r;
+                float dfx = 1 + t2 * (3 * l.k[0] + t2 * (5 * l.k[1] + t2 * (7 * l.k[2] + t2 * 9 * l.k[3])));
+                if (dfx == 0)
+                    break;
+                float step = fx / dfx;
+                theta -= step;
+                if (std::fabs(step) < 1e-7f)
+                    break;
+            }
+            return theta;
+        }
+
+        default:
+            return atan(r);
+    }
+}
+
+float
+lens_focal(camgazebo_projection model, const float k[4], float hfov, float w)
+{
+    lens l = { model, { k[0], k[1], k[2], k[3] }, 1, 0, 0 };
+    return w / 2 / lens_radius(l, hfov / 2);
+}
+
+void
+reprojection_maps(const lens& in, const lens& out, uint16_t w, uint16_t h,
+                  std::vector<float>& map_x, std::vector<float>& map_y)
+{
+    map_x.resize(w * h);
+    map_y.resize(w * h);
+
+    for (uint16_t v = 0; v < h; v++)
+        for (uint16_t u = 0; u < w; u++)
+        {
+            float x = (u - out.cx) / out.f;
+            float y = (v - out.cy) / out.f;
+            float r = std::sqrt(x * x + y * y);
+            size_t i = v * w + u;
+
+            if (r == 0)
+            {
+                map_x[i] = in.cx;
+                map_y[i] = in.cy;
+                continue;
+            }
+
+            float theta = lens_theta(out, r);
+            if (in.model == camgazebo_proj_pinhole && theta >= M_PI / 2)
+            {
+                map_x[i] = map_y[i] = -1;
+                continue;
+            }
+
+            float s = in.f * lens_radius(in, theta) / r;
+            map_x[i] = in.cx + s * x;
+            map_y[i] = in.cy + s * y;
+        }
+}
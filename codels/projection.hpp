@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#ifndef H_CAMGAZEBO_PROJECTION
+#define H_CAMGAZEBO_PROJECTION
+
+#include "camgazebo_c_types.h"
+
+#include <cstdint>
+#include <vector>
+
+// Radial projection models, mapping the angle theta between a ray and the
+// optical axis to the distance r/f of its image from the principal point:
+//   pinhole            tan(theta)
+//   equidistant        theta
+//   kannala_brandt     theta (1 + k1 theta^2 + k2 theta^4 + k3 theta^6 + k4 theta^8)
+struct lens {
+    camgazebo_projection model;
+    float k[4];     // kannala_brandt coefficients
+    float f, cx, cy;
+};
+
+float lens_radius(const lens& l, float theta);
+float lens_theta(const lens& l, float r);
+
+// Focal length giving the horizontal field of view hfov over w pixels.
+float lens_focal(camgazebo_projection model, const float k[4], float hfov, float w);
+
+// For each pixel of an image of size w x h with projection out, fill the
+// coordinates of the pixel seeing the same ray through projection in.
+// Rays not seen by in are mapped outside the image.
+void reprojection_maps(const lens& in, const lens& out, uint16_t w, uint16_t h,
+                       std::vector<float>& map_x, std::vector<float>& map_y);
+
+#endif /* H_CAMGAZEBO_PROJECTION */
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include "accamgazebo.h"
+
+#include "dispatch.hpp"
+#include "resample.hpp"
+
+#include <cmath>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+
+/* --- Weighted row accumulation kernels ---------------------------------- */
+
+void
+row_accumulate_scalar(float* acc, const uint8_t* src, float w, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        acc[i] += w * src[i];
+}
+
+#if defined(__x86_64__)
+void
+row_accumulate_sse2(float* acc, const uint8_t* src, float w, size_t n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 vw = _mm_set1_ps(w);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i lo = _mm_unpacklo_epi8(b, zero);
+        __m128i hi = _mm_unpackhi_epi8(b, zero);
+        __m128i q[4] = {
+            _mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+            _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero)
+        };
+        for (int k = 0; k < 4; k++)
+        {
+            __m128 a = _mm_loadu_ps(acc + i + 4 * k);
+            a = _mm_add_ps(a, _mm_mul_ps(vw, _mm_cvtepi32_ps(q[k])));
+            _mm_storeu_ps(acc + i + 4 * k, a);
+        }
+    }
+    row_accumulate_scalar(acc + i, src + i, w, n - i);
+}
+
+__attribute__((target("avx2"))) void
+row_accumulate_avx2(float* acc, const uint8_t* src, float w, size_t n)
+{
+    const __m256 vw = _mm256_set1_ps(w);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i));
+        __m256 f0 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(b));
+        __m256 f1 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(b, 8)));
+        _mm256_storeu_ps(acc + i, _mm256_add_ps(_mm256_loadu_ps(acc + i), _mm256_mul_ps(vw, f0)));
+        _mm256_storeu_ps(acc + i + 8, _mm256_add_ps(_mm256_loadu_ps(acc + i + 8), _mm256_mul_ps(vw, f1)));
+    }
+    row_accumulate_scalar(acc + i, src + i, w, n - i);
+}
+#endif
+
+#if defined(__ARM_NEON)
+void
+row_accumulate_neon(float* acc, const uint8_t* src, float w, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        uint16x8_t b = vmovl_u8(vld1_u8(src + i));
+        float32x4_t f0 = vcvtq_f32_u32(vmovl_u16(vget_low_u16(b)));
+        float32x4_t f1 = vcvtq_f32_u32(vmovl_u16(vget_high_u16(b)));
+        vst1q_f32(acc + i, vmlaq_n_f32(vld1q_f32(acc + i), f0, w));
+        vst1q_f32(acc + i + 4, vmlaq_n_f32(vld1q_f32(acc + i + 4), f1, w));
+    }
+    row_accumulate_scalar(acc + i, src + i, w, n - i);
+}
+#endif
+
+
+/* --- Coefficient tables ------------------------------------------------- */
+
+void
+area_axis::build(uint32_t src, uint32_t dst)
+{
+    double s = (double)src / dst;
+    taps = (uint16_t)std::ceil(s) + 1;
+    first.assign(dst, 0);
+    count.assign(dst, 0);
+    weights.assign((size_t)dst * taps, 0.f);
+    center.assign(dst, 0);
+
+    for (uint32_t i = 0; i < dst; i++)
+    {
+        double a = i * s, b = (i + 1) * s;
+        uint32_t f = (uint32_t)a;
+
+        first[i] = f;
+        for (uint32_t j = f; j < src && j < b && j - f < taps; j++)
+            weights[(size_t)i * taps + count[i]++] = (std::min(b, j + 1.) - std::max(a, (double)j)) / s;
+        center[i] = std::min(src - 1, (uint32_t)((a + b) / 2));
+    }
+}
+
+void
+area_resampler::configure(uint16_t sw, uint16_t sh, uint16_t dw, uint16_t dh, uint16_t bpp)
+{
+    active = sw != dw || sh != dh;
+    if (!active)
+    {
+        acc.clear();
+        scratch.clear();
+        return;
+    }
+
+    x.build(sw, dw);
+    y.build(sh, dh);
+    acc.resize((size_t)sw * bpp);
+    scratch.resize((size_t)dw * dh * bpp);
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#ifndef H_CAMGAZEBO_RESAMPLE
+#define H_CAMGAZEBO_RESAMPLE
+
+#include "camgazebo_c_types.h"
+
+#include "dispatch.hpp"
+#include "frame_view.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Area (box filter) downsampling from the rendered size to the published
+// one: each output pixel averages the source pixels it covers, weighted by
+// their overlap, which anti-aliases frames rendered larger than published.
+// The filter is separable and its weights only depend on the sizes, so they
+// are tabulated per axis when the sizes change.
+struct area_axis {
+    uint16_t taps = 0;              // max source samples per output sample
+    std::vector<uint32_t> first;    // first source sample of each output sample
+    std::vector<uint16_t> count;    // source samples of each output sample
+    std::vector<float> weights;     // taps per output sample, summing to 1
+    std::vector<uint32_t> center;   // source sample under the output center
+
+    void build(uint32_t src, uint32_t dst);
+};
+
+struct area_resampler {
+    bool active = false;            // published size differs from the rendered one
+    area_axis x;
+    area_axis y;
+    std::vector<float> acc;         // vertically filtered source row
+    std::vector<uint8_t> scratch;   // resampled frame, when reprojected afterwards
+
+    void configure(uint16_t sw, uint16_t sh, uint16_t dw, uint16_t dh, uint16_t bpp);
+};
+
+// 8 bits channels; rows are accumulated with the dispatched kernel, columns
+// with the pixel layout fixed at compile time
+template <uint16_t C>
+void area_resample(area_resampler& r, const frame_view& src, const frame_view& dst)
+{
+    size_t n = (size_t)src.w * C;
+    float* acc = r.acc.data();
+
+    for (uint16_t oy = 0; oy < dst.h; oy++)
+    {
+        const float* wy = &r.y.weights[(size_t)oy * r.y.taps];
+        std::fill(acc, acc + n, 0.f);
+        for (uint16_t t = 0; t < r.y.count[oy]; t++)
+            kernels.row_accumulate(acc, src.data + (r.y.first[oy] + t) * src.stride, wy[t], n);
+
+        uint8_t* out = dst.data + oy * dst.stride;
+        for (uint16_t ox = 0; ox < dst.w; ox++)
+        {
+            const float* wx = &r.x.weights[(size_t)ox * r.x.taps];
+            const float* a = acc + (size_t)r.x.first[ox] * C;
+            float s[C] = {};
+            for (uint16_t t = 0; t < r.x.count[ox]; t++)
+                for (uint16_t k = 0; k < C; k++)
+                    s[k] += wx[t] * a[t * C + k];
+            for (uint16_t k = 0; k < C; k++)
+                out[ox * C + k] = (uint8_t)std::min(s[k] + .5f, 255.f);
+        }
+    }
+}
+
+// labels must not be averaged, each output pixel takes the source pixel
+// under its center
+template <uint16_t B>
+void nearest_resample(const area_resampler& r, const frame_view& src, const frame_view& dst)
+{
+    for (uint16_t oy = 0; oy < dst.h; oy++)
+    {
+        const uint8_t* in = src.data + r.y.center[oy] * src.stride;
+        uint8_t* out = dst.data + oy * dst.stride;
+        for (uint16_t ox = 0; ox < dst.w; ox++)
+            memcpy(out + ox * B, in + r.x.center[ox] * B, B);
+    }
+}
+
+#endif /* H_CAMGAZEBO_RESAMPLE */
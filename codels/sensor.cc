@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include "accamgazebo.h"
+
+#include "sensor.hpp"
+
+#include <gazebo/common/Time.hh>
+
+#include <err.h>
+#include <sstream>
+#include <vector>
+
+
+/* --- camgazebo_sensor_s ------------------------------------------------- */
+
+bool
+camgazebo_sensor_s::attach(gazebo::transport::NodePtr node, const std::string& image_topic)
+{
+    std::vector<std::string> parts;
+    std::istringstream s(image_topic);
+    for (std::string p; std::getline(s, p, '/');)
+        if (!p.empty())
+            parts.push_back(p);
+
+    // drop the namespace, either ~ or gazebo/<world>
+    size_t first = 0;
+    if (!parts.empty() && parts[0] == "~")
+        first = 1;
+    else if (!parts.empty() && parts[0] == "gazebo")
+        first = 2;
+
+    // at least a link, the sensor and the image topic itself
+    if (parts.size() < first + 3)
+    {
+        detach();
+        return false;
+    }
+
+    name = parts[parts.size() - 2];
+    parent.clear();
+    for (size_t i = first; i < parts.size() - 2; i++)
+        parent += (parent.empty() ? "" : "::") + parts[i];
+
+    this->node = node;
+    pub.reset();
+    return true;
+}
+
+void
+camgazebo_sensor_s::detach()
+{
+    pub.reset();
+    node.reset();
+    name.clear();
+    parent.clear();
+}
+
+void
+camgazebo_sensor_s::request(bool active, double rate, bool block)
+{
+    this->active = active;
+    this->rate = rate;
+    if (!attached() || !node)
+        return;
+
+    // the first request is lost if sent before the plugin is connected
+    if (!pub)
+    {
+        pub = node->Advertise<gazebo::msgs::Sensor>(topic);
+        pub->WaitForConnection(gazebo::common::Time(1, 0));
+    }
+
+    gazebo::msgs::Sensor msg;
+    msg.set_name(name);
+    msg.set_parent(parent);
+    msg.set_type("camera");
+    msg.set_always_on(active);
+    if (rate > 0)
+        msg.set_update_rate(rate);
+    if (width && height)
+    {
+        gazebo::msgs::CameraSensor* camera = msg.mutable_camera();
+        camera->mutable_image_size()->set_x(width);
+        camera->mutable_image_size()->set_y(height);
+        camera->set_image_format(format);
+    }
+
+    pub->Publish(msg, block);
+    requests++;
+}
+
+void
+camgazebo_sensor_s::request_image(uint16_t width, uint16_t height, const char* format)
+{
+    this->width = width;
+    this->height = height;
+    this->format = format;
+    request(active, rate);
+}
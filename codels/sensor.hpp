@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#ifndef H_CAMGAZEBO_SENSOR
+#define H_CAMGAZEBO_SENSOR
+
+#include "camgazebo_c_types.h"
+
+#include <gazebo/transport/transport.hh>
+#include <gazebo/msgs/msgs.hh>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Control of the gazebo camera producing the frames, so that it only
+// renders at the rate frames are published and not at all once nobody
+// consumes them. Requests are msgs::Sensor published on a control topic
+// (~/sensor by default) and applied by the camgazebo_sensor_control world
+// plugin (plugins/sensor_control.cc); the sensor is named after the image
+// topic, /gazebo/<world>/<model>/<link>/<sensor>/image. always_on carries
+// the requested activation, which the plugin applies with SetActive.
+struct camgazebo_sensor_s {
+    bool enabled = false;
+    std::string topic = "~/sensor";
+
+    std::string name;           // of the sensor, empty if not attached
+    std::string parent;         // scoped name of its link
+    bool active = false;        // last requested state
+    double rate = 0;            // last requested update rate (Hz), 0 for the sdf one
+    uint16_t width = 0;         // last requested image size, 0 for the sdf one
+    uint16_t height = 0;
+    std::string format;         // gazebo pixel format, e.g. R8G8B8
+    uint32_t requests = 0;
+
+    // set_format waits for a frame beyond this count until the deadline
+    uint64_t pending_after = 0;
+    std::chrono::steady_clock::time_point pending_deadline;
+    // and goes back to this format on timeout
+    struct format_s {
+        uint16_t w, h, c, d;    // rendered frames, d in bytes
+        uint16_t ow, oh;        // published frames
+        uint16_t width, height; // image request, 0 for the sdf one
+        std::string format;
+    } previous;
+
+    // take the sensor name from the image topic; false if it has not the
+    // expected form
+    bool attach(gazebo::transport::NodePtr node, const std::string& image_topic);
+    void detach();
+    bool attached() const { return !name.empty(); }
+    void set_topic(const std::string& t) { topic = t; pub.reset(); }
+
+    // publish the requested state; block until sent, e.g. before shutdown
+    void request(bool active, double rate, bool block = false);
+    // same with the image settings, kept for later requests
+    void request_image(uint16_t width, uint16_t height, const char* format);
+
+  private:
+    gazebo::transport::NodePtr node;
+    gazebo::transport::PublisherPtr pub;
+};
+
+#endif /* H_CAMGAZEBO_SENSOR */
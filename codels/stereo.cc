@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include "accamgazebo.h"
+
+#include "stereo.hpp"
+
+#include <algorithm>
+
+
+/* --- Rectification maps ------------------------------------------------- */
+
+static cv::Matx33d
+rotation(float roll, float pitch, float yaw)
+{
+    cv::Matx33d rx(1, 0, 0, 0, cos(roll), -sin(roll), 0, sin(roll), cos(roll));
+    cv::Matx33d ry(cos(pitch), 0, sin(pitch), 0, 1, 0, -sin(pitch), 0, cos(pitch));
+    cv::Matx33d rz(cos(yaw), -sin(yaw), 0, sin(yaw), cos(yaw), 0, 0, 0, 1);
+    return rz * ry * rx;
+}
+
+// Rebuild the rectification maps if the calibration or the size changed
+// since they were last computed. Returns true if the maps were rebuilt.
+bool
+camgazebo_stereo_s::update_maps(const or_sensor_intrinsics* intr, const or_sensor_extrinsics* ext,
+                                uint16_t w, uint16_t h)
+{
+    if (!maps_dirty)
+        return false;
+    maps_dirty = false;
+
+    // both cameras share the component intrinsics
+    cv::Matx33d K(intr->calib.fx, intr->calib.gamma, intr->calib.cx,
+                  0, intr->calib.fy, intr->calib.cy,
+                  0, 0, 1);
+    cv::Matx<double, 1, 5> D(intr->disto.k1, intr->disto.k2, intr->disto.p1, intr->disto.p2, intr->disto.k3);
+
+    // extrinsics are camera to body transforms, p_b = R_i p_i + t_i, hence
+    // p_r = R_r^T R_l p_l + R_r^T (t_l - t_r) as expected by stereoRectify
+    cv::Matx33d Rl = rotation(ext->rot.roll, ext->rot.pitch, ext->rot.yaw);
+    cv::Matx33d Rr = rotation(right_ext[3], right_ext[4], right_ext[5]);
+    cv::Vec3d tl(ext->trans.tx, ext->trans.ty, ext->trans.tz);
+    cv::Vec3d tr(right_ext[0], right_ext[1], right_ext[2]);
+    cv::Matx33d R = Rr.t() * Rl;
+    cv::Vec3d T = Rr.t() * (tl - tr);
+
+    cv::Mat R1, R2, P1, P2, Q;
+    cv::stereoRectify(K, D, K, D, cv::Size(w, h), R, T, R1, R2, P1, P2, Q, cv::CALIB_ZERO_DISPARITY, 0);
+
+    // fixed-point maps make the per-frame remap noticeably cheaper
+    cv::initUndistortRectifyMap(K, D, R1, P1, cv::Size(w, h), CV_16SC2, map_left[0], map_left[1]);
+    cv::initUndistortRectifyMap(K, D, R2, P2, cv::Size(w, h), CV_16SC2, map_right[0], map_right[1]);
+
+    return true;
+}
+
+void
+camgazebo_stereo_s::remap(int i, const uint8_t* src, uint8_t* dst, uint16_t w, uint16_t h, uint16_t c)
+{
+    const cv::Mat* map = i == 0 ? map_left : map_right;
+
+    cv::Mat in(cv::Size(w, h), CV_8UC(c), const_cast<uint8_t*>(src));
+    cv::Mat out(cv::Size(w, h), CV_8UC(c), dst);
+    cv::remap(in, out, map[0], map[1], cv::INTER_LINEAR);
+}
+
+
+/* --- Disparity ---------------------------------------------------------- */
+
+// Split the rectified pair in horizontal strips matched in parallel on the
+// worker pool. Strips overlap by half a block so that rows computed from the
+// image border are discarded, and the result is identical to a single pass.
+// Only called when no previous computation is in flight.
+void
+camgazebo_stereo_s::start_disparity(const uint8_t* l, const uint8_t* r, uint16_t w, uint16_t h, uint16_t c,
+                                    or_time_ts ts)
+{
+    const uint8_t* src[2] = { l, r };
+    for (int i = 0; i < 2; i++)
+    {
+        cv::Mat in(cv::Size(w, h), CV_8UC(c), const_cast<uint8_t*>(src[i]));
+        if (c == 1)
+            in.copyTo(disp_in[i]);
+        else
+            cv::cvtColor(in, disp_in[i], cv::COLOR_RGB2GRAY);
+    }
+    disp_out.create(h, w, CV_16S);
+
+    if (!pool)
+        pool.reset(new worker_pool());
+
+    int margin = block_size / 2;
+    int rows = std::max<int>((h + pool->size() - 1) / pool->size(), block_size);
+    unsigned strips = (h + rows - 1) / rows;
+
+    if (matchers.size() != strips
+        || matchers[0]->getNumDisparities() != num_disparities
+        || matchers[0]->getBlockSize() != block_size)
+    {
+        matchers.clear();
+        for (unsigned k = 0; k < strips; k++)
+            matchers.push_back(cv::StereoBM::create(num_disparities, block_size));
+    }
+
+    disp_ts = ts;
+    disp_busy = true;
+    disp_pending = strips;
+
+    for (unsigned k = 0; k < strips; k++)
+    {
+        int y0 = k * rows;
+        int y1 = std::min<int>(h, y0 + rows);
+
+        pool->submit([this, k, y0, y1, margin, h]() {
+            int a = std::max(0, y0 - margin);
+            int b = std::min<int>(h, y1 + margin);
+
+            cv::Mat d;
+            matchers[k]->compute(disp_in[0].rowRange(a, b), disp_in[1].rowRange(a, b), d);
+            d.rowRange(y0 - a, y1 - a).copyTo(disp_out.rowRange(y0, y1));
+
+            disp_pending--;
+        });
+    }
+}
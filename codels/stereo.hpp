@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#ifndef H_CAMGAZEBO_STEREO
+#define H_CAMGAZEBO_STEREO
+
+#include "camgazebo_c_types.h"
+
+#include "spsc_queue.hpp"
+#include "worker_pool.hpp"
+
+#include <gazebo/transport/transport.hh>
+#include <gazebo/msgs/msgs.hh>
+#include <opencv2/opencv.hpp>
+
+#include <err.h>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct camgazebo_stereo_s {
+    struct side {
+        int32_t sec;
+        int32_t nsec;
+        std::vector<uint8_t> pixels;
+
+        double stamp() const { return sec + nsec * 1e-9; }
+    };
+    typedef spsc_queue<side, 8> queue;
+
+    bool enabled = false;
+    double tolerance = 1e-3;    // max sim time difference (sec) within a pair
+    std::atomic<uint64_t> l{0}; // expected frame size, same for both cameras
+
+    gazebo::transport::SubscriberPtr sub_left;
+    gazebo::transport::SubscriberPtr sub_right;
+    queue left;
+    queue right;
+
+    // only used to wake up the main task, the queues themselves are lock-free
+    std::mutex m;
+    std::condition_variable cv;
+
+    std::atomic<uint32_t> pairs{0};
+    std::atomic<uint32_t> unmatched_left{0};
+    std::atomic<uint32_t> unmatched_right{0};
+
+    // rectification and disparity, see stereo.cc
+    bool rectify = false;
+    bool disparity = false;
+    uint16_t num_disparities = 64;
+    uint16_t block_size = 15;
+    float right_ext[6] = {0,0,0,0,0,0}; // right camera, same convention as the extrinsics port
+
+    bool maps_dirty = true;             // calibration or size changed since the maps were built
+    cv::Mat map_left[2];
+    cv::Mat map_right[2];
+
+    cv::Mat disp_in[2];
+    cv::Mat disp_out;
+    or_time_ts disp_ts;
+    bool disp_busy = false;
+    std::atomic<unsigned> disp_pending{0};
+    std::vector<cv::Ptr<cv::StereoBM>> matchers;
+    std::unique_ptr<worker_pool> pool;  // declared last: joined before the buffers it uses are freed
+
+    bool update_maps(const or_sensor_intrinsics* intr, const or_sensor_extrinsics* ext,
+                     uint16_t w, uint16_t h);
+    void remap(int i, const uint8_t* src, uint8_t* dst, uint16_t w, uint16_t h, uint16_t c);
+    void start_disparity(const uint8_t* l, const uint8_t* r, uint16_t w, uint16_t h, uint16_t c,
+                         or_time_ts ts);
+    bool disparity_ready() const { return disp_busy && disp_pending == 0; }
+
+    void cb_left(ConstImageStampedPtr &_msg) { push(left, unmatched_left, _msg); }
+    void cb_right(ConstImageStampedPtr &_msg) { push(right, unmatched_right, _msg); }
+
+    void push(queue &q, std::atomic<uint32_t> &unmatched, ConstImageStampedPtr &_msg)
+    {
+        const std::string &img = _msg->image().data();
+        if (img.length() != l.load(std::memory_order_relaxed))
+        {
+            unmatched++;
+            return;
+        }
+
+        side* s = q.claim();
+        if (!s)
+        {
+            // consumer is late, drop the newest frame rather than blocking gazebo
+            unmatched++;
+            return;
+        }
+        s->sec = _msg->time().sec();
+        s->nsec = _msg->time().nsec();
+        s->pixels.resize(img.length());
+        memcpy(s->pixels.data(), img.data(), img.length()); // sizeof *img.data() == 1
+        q.commit();
+
+        { std::lock_guard<std::mutex> guard(m); }
+        cv.notify_all();
+    }
+
+    // Consumer side: discard heads that cannot be paired anymore and return
+    // true when the heads of both queues are within tolerance.
+    // Stamps are monotonic on each side, so the older of two unmatched heads
+    // can only get further away from the next frames of the other camera.
+    bool match()
+    {
+        for (;;)
+        {
+            side* sl = left.front();
+            side* sr = right.front();
+            if (!sl || !sr)
+                return false;
+
+            double dt = sl->stamp() - sr->stamp();
+            if (std::fabs(dt) <= tolerance)
+                return true;
+
+            if (dt < 0)
+            {
+                left.pop();
+                unmatched_left++;
+            }
+            else
+            {
+                right.pop();
+                unmatched_right++;
+            }
+        }
+    }
+
+    void reset()
+    {
+        sub_left.reset();
+        sub_right.reset();
+        left.clear();
+        right.clear();
+        enabled = false;
+    }
+};
+
+#endif /* H_CAMGAZEBO_STEREO */
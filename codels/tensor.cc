@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include "accamgazebo.h"
+
+#include "dispatch.hpp"
+#include "tensor.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+/* --- Sampling tables ---------------------------------------------------- */
+
+// bilinear taps of n tensor samples over src samples, pixel centers aligned
+static void
+bilinear_taps(uint16_t n, uint16_t src, float scale, uint32_t step,
+              std::vector<uint32_t>& i0, std::vector<uint32_t>& i1, std::vector<float>& w)
+{
+    i0.resize(n);
+    i1.resize(n);
+    w.resize(n);
+    for (uint16_t i = 0; i < n; i++)
+    {
+        float s = std::min(std::max((i + .5f) / scale - .5f, 0.f), src - 1.f);
+        uint32_t k = (uint32_t)s;
+        i0[i] = k * step;
+        i1[i] = std::min<uint32_t>(k + 1, src - 1) * step;
+        w[i] = s - k;
+    }
+}
+
+
+/* --- camgazebo_tensorizer_s --------------------------------------------- */
+
+bool
+camgazebo_tensorizer_s::configure(const frame_view& f, camgazebo_tensor_frame* out)
+{
+    uint16_t c = std::min<uint16_t>(f.c, 3);
+    float rx = (float)w / f.w, ry = (float)h / f.h;
+
+    if (letterbox)
+        rx = ry = std::min(rx, ry);
+    cw = std::min<uint16_t>(w, (uint16_t)std::lround(f.w * rx));
+    ch = std::min<uint16_t>(h, (uint16_t)std::lround(f.h * ry));
+    px = (w - cw) / 2;
+    py = (h - ch) / 2;
+
+    bilinear_taps(cw, f.w, rx, f.c, x0, x1, wx);
+    bilinear_taps(ch, f.h, ry, 1, y0, y1, wy);
+    acc.resize((size_t)f.w * f.c);
+
+    // quantization folded in the normalization
+    for (uint16_t k = 0; k < c; k++)
+    {
+        a[k] = 1 / std[k];
+        b[k] = -mean[k] / std[k];
+        if (type == camgazebo_tensor_int8)
+        {
+            a[k] /= quant_scale;
+            b[k] = b[k] / quant_scale + quant_zero;
+        }
+    }
+
+    size_t elem = type == camgazebo_tensor_int8 ? 1 : sizeof(float);
+    size_t l = (size_t)c * w * h * elem;
+    if (l > out->data._maximum)
+        if (genom_sequence_reserve(&(out->data), l) == -1)
+            return false;
+    out->data._length = l;
+
+    out->type = type;
+    out->channels = c;
+    out->width = w;
+    out->height = h;
+    out->scale_x = rx;
+    out->scale_y = ry;
+    out->pad_x = px;
+    out->pad_y = py;
+    out->quant_scale = quant_scale;
+    out->quant_zero = quant_zero;
+
+    // the padding is written once, fill only covers the image area
+    for (uint16_t k = 0; k < c; k++)
+    {
+        float v = pad * a[k] + b[k];
+        size_t plane = (size_t)w * h;
+        if (type == camgazebo_tensor_int8)
+        {
+            int8_t q = (int8_t)std::min(std::max(std::lrint(v), -128L), 127L);
+            std::fill((int8_t*)out->data._buffer + k * plane, (int8_t*)out->data._buffer + (k + 1) * plane, q);
+        }
+        else
+            std::fill((float*)out->data._buffer + k * plane, (float*)out->data._buffer + (k + 1) * plane, v);
+    }
+
+    sw = f.w;
+    sh = f.h;
+    sc = f.c;
+    return true;
+}
+
+static inline void
+store(float* p, float v) { *p = v; }
+
+static inline void
+store(int8_t* p, float v) { *p = (int8_t)std::min(std::max(std::lrint(v), -128L), 127L); }
+
+template <uint16_t C, typename T>
+void
+camgazebo_tensorizer_s::fill(const frame_view& f, T* out)
+{
+    size_t plane = (size_t)w * h;
+    size_t n = (size_t)f.w * C;
+    float* r = acc.data();
+
+    for (uint16_t oy = 0; oy < ch; oy++)
+    {
+        // vertical interpolation of the whole source row, vectorized
+        std::fill(r, r + n, 0.f);
+        kernels.row_accumulate(r, f.data + y0[oy] * f.stride, 1 - wy[oy], n);
+        kernels.row_accumulate(r, f.data + y1[oy] * f.stride, wy[oy], n);
+
+        T* o = out + (size_t)(py + oy) * w + px;
+        for (uint16_t ox = 0; ox < cw; ox++)
+        {
+            const float* p0 = r + x0[ox];
+            const float* p1 = r + x1[ox];
+            for (uint16_t k = 0; k < C; k++)
+            {
+                float v = p0[k] + wx[ox] * (p1[k] - p0[k]);
+                store(o + k * plane + ox, v * a[k] + b[k]);
+            }
+        }
+    }
+}
+
+bool
+camgazebo_tensorizer_s::update(const frame_view& f, camgazebo_tensor_frame* out)
+{
+    if ((f.w != sw || f.h != sh || f.c != sc) && !configure(f, out))
+        return false;
+
+    if (type == camgazebo_tensor_int8)
+    {
+        int8_t* p = (int8_t*)out->data._buffer;
+        if (f.c == 1)
+            fill<1>(f, p);
+        else
+            fill<3>(f, p);
+    }
+    else
+    {
+        float* p = (float*)out->data._buffer;
+        if (f.c == 1)
+            fill<1>(f, p);
+        else
+            fill<3>(f, p);
+    }
+
+    return true;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#ifndef H_CAMGAZEBO_TENSOR
+#define H_CAMGAZEBO_TENSOR
+
+#include "camgazebo_c_types.h"
+
+#include "frame_view.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Network input tensor from the raw frame: bilinear resize, optional
+// letterbox, per channel normalization (v - mean) / std, HWC to CHW
+// transposition and int8 quantization, fused in a single pass over the
+// frame. The sampling tables and the padding only depend on the settings
+// and the frame format; they are rebuilt when either changes, so steady
+// state only writes the image area of the preallocated tensor.
+struct camgazebo_tensorizer_s {
+    bool enabled = false;
+    uint16_t w = 640;
+    uint16_t h = 640;
+    bool letterbox = true;          // keep the aspect ratio, pad the rest
+    float pad = 114;                // padding, before normalization
+    float mean[3] = {0, 0, 0};      // 0-255 scale
+    float std[3] = {255, 255, 255};
+    camgazebo_tensor_type type = camgazebo_tensor_f32;
+    float quant_scale = 1.f / 128;  // int8: value = quant_scale * (q - quant_zero)
+    int16_t quant_zero = 0;
+
+    // rebuild the tables on the next update
+    void invalidate() { sw = 0; }
+
+    // fill out from f, 8 bits per channel; false on allocation failure
+    bool update(const frame_view& f, camgazebo_tensor_frame* out);
+
+  private:
+    bool configure(const frame_view& f, camgazebo_tensor_frame* out);
+    template <uint16_t C, typename T>
+    void fill(const frame_view& f, T* out);
+
+    uint16_t sw = 0, sh = 0, sc = 0;    // frame format of the tables
+    uint16_t cw = 0, ch = 0;            // image area of the tensor
+    uint16_t px = 0, py = 0;
+    std::vector<uint32_t> x0, x1;       // source columns (byte offsets) of each tensor column
+    std::vector<float> wx;
+    std::vector<uint32_t> y0, y1;       // source rows of each tensor row
+    std::vector<float> wy;
+    std::vector<float> acc;             // vertically interpolated source row
+    float a[3], b[3];                   // normalization and quantization, v * a + b
+};
+
+#endif /* H_CAMGAZEBO_TENSOR */
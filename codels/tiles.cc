@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include "accamgazebo.h"
+
+#include "pipeline.hpp"
+#include "tiles.hpp"
+
+#include <cstring>
+
+
+/* --- Tile hash ---------------------------------------------------------- */
+
+// 64 bits multiply-rotate hash over the rows of a tile, 8 bytes at a time
+static uint64_t
+tile_hash(const uint8_t* p, size_t stride, size_t row, uint16_t rows)
+{
+    const uint64_t k = 0x9e3779b97f4a7c15ULL;
+    uint64_t h = row * k;
+
+    for (uint16_t r = 0; r < rows; r++, p += stride)
+    {
+        size_t i = 0;
+        for (; i + 8 <= row; i += 8)
+        {
+            uint64_t v;
+            memcpy(&v, p + i, 8);
+            h = ((h ^ v) * k);
+            h ^= h >> 29;
+        }
+        uint64_t v = 0;
+        memcpy(&v, p + i, row - i);
+        h = ((h ^ v ^ r) * k);
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+
+/* --- camgazebo_tiler_s -------------------------------------------------- */
+
+bool
+camgazebo_tiler_s::encode(const frame_view& f, const pixel_pipeline& pipeline, uint16_t x, uint16_t y,
+                          uint16_t tw, uint16_t th, camgazebo_tile_update* out)
+{
+    frame_view t(f.data + y * f.stride + x * f.bpp(), tw, th, f.c, f.d, f.own, f.stride);
+    cv::imencode(pipeline.export_ext, t.mat(), buf, params);
+
+    uint32_t n = out->tiles._length;
+    if (n + 1 > out->tiles._maximum)
+        if (genom_sequence_reserve(&(out->tiles), 2 * (n + 1)) == -1)
+            return false;
+    if (out->data._length + buf.size() > out->data._maximum)
+        if (genom_sequence_reserve(&(out->data), 2 * (out->data._length + buf.size())) == -1)
+            return false;
+
+    camgazebo_tile* tile = &out->tiles._buffer[out->tiles._length++];
+    tile->x = x;
+    tile->y = y;
+    tile->width = tw;
+    tile->height = th;
+    tile->offset = out->data._length;
+    tile->length = buf.size();
+    memcpy(out->data._buffer + out->data._length, buf.data(), buf.size());
+    out->data._length += buf.size();
+    return true;
+}
+
+int
+camgazebo_tiler_s::update(const frame_view& f, const pixel_pipeline& pipeline, camgazebo_tile_update* out)
+{
+    uint16_t cols = (f.w + size - 1) / size;
+    uint16_t rows = (f.h + size - 1) / size;
+    bool keyframe = f.w != w || f.h != h || f.bpp() != bpp || hashes.size() != (size_t)cols * rows
+                  || since_keyframe + 1 >= keyframe_interval;
+
+    if (hashes.size() != (size_t)cols * rows)
+        hashes.assign((size_t)cols * rows, 0);
+    w = f.w;
+    h = f.h;
+    bpp = f.bpp();
+
+    dirty.clear();
+    for (uint16_t ty = 0; ty < rows; ty++)
+        for (uint16_t tx = 0; tx < cols; tx++)
+        {
+            uint16_t x = tx * size, y = ty * size;
+            uint16_t tw = std::min<int>(size, f.w - x), th = std::min<int>(size, f.h - y);
+            uint64_t hash = tile_hash(f.data + y * f.stride + x * f.bpp(), f.stride, (size_t)tw * f.bpp(), th);
+
+            uint32_t i = ty * cols + tx;
+            if (hash != hashes[i])
+            {
+                hashes[i] = hash;
+                dirty.push_back(i);
+            }
+        }
+
+    // one image compresses better than most of its tiles
+    if (2 * dirty.size() > hashes.size())
+        keyframe = true;
+    if (!keyframe && dirty.empty())
+    {
+        since_keyframe++;
+        return 0;
+    }
+
+    params.clear();
+    if (pipeline.jpeg)
+        params = { cv::IMWRITE_JPEG_QUALITY, quality };
+
+    out->seq = ++seq;
+    out->keyframe = keyframe;
+    out->width = f.w;
+    out->height = f.h;
+    out->tiles._length = 0;
+    out->data._length = 0;
+
+    if (keyframe)
+    {
+        if (!encode(f, pipeline, 0, 0, f.w, f.h, out))
+            return -1;
+        keyframe_seq = seq;
+        since_keyframe = 0;
+        keyframes++;
+    }
+    else
+    {
+        for (uint32_t i : dirty)
+        {
+            uint16_t x = (i % cols) * size, y = (i / cols) * size;
+            if (!encode(f, pipeline, x, y, std::min<int>(size, f.w - x), std::min<int>(size, f.h - y), out))
+                return -1;
+        }
+        since_keyframe++;
+        tiles += dirty.size();
+    }
+
+    out->keyframe_seq = keyframe_seq;
+    updates++;
+    return 1;
+}
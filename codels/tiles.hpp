@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#ifndef H_CAMGAZEBO_TILES
+#define H_CAMGAZEBO_TILES
+
+#include "camgazebo_c_types.h"
+
+#include "frame_view.hpp"
+
+#include <cstdint>
+#include <vector>
+
+struct pixel_pipeline;
+
+// Dirty region updates: frames are split in square tiles, and only the
+// tiles whose hash changed since the previous update are encoded. A
+// keyframe, a single tile covering the whole frame, is sent on format
+// changes, when most tiles changed anyway, and every keyframe_interval
+// frames even if nothing changed, so that a reader that missed an update
+// resyncs.
+struct camgazebo_tiler_s {
+    bool enabled = false;
+    uint16_t size = 64;             // tile side (pixels)
+    uint16_t keyframe_interval = 30;   // frames
+    int16_t quality = 80;
+
+    uint32_t updates = 0;
+    uint32_t keyframes = 0;
+    uint32_t tiles = 0;             // sent, keyframes excluded
+
+    // force a keyframe on the next update
+    void reset() { hashes.clear(); }
+
+    // fill out with the update of f; returns 1 if there is something to
+    // publish, 0 if nothing changed and -1 on allocation failure
+    int update(const frame_view& f, const pixel_pipeline& pipeline, camgazebo_tile_update* out);
+
+  private:
+    bool encode(const frame_view& f, const pixel_pipeline& pipeline, uint16_t x, uint16_t y,
+                uint16_t tw, uint16_t th, camgazebo_tile_update* out);
+
+    std::vector<uint64_t> hashes;
+    uint16_t w = 0, h = 0, bpp = 0;
+    uint32_t since_keyframe = 0;    // frames
+    uint32_t seq = 0, keyframe_seq = 0;     // never reset, seen by clients
+    std::vector<uint8_t> buf;
+    std::vector<int32_t> params;
+    std::vector<uint32_t> dirty;
+};
+
+#endif /* H_CAMGAZEBO_TILES */
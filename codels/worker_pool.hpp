@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#ifndef H_CAMGAZEBO_WORKER_POOL
+#define H_CAMGAZEBO_WORKER_POOL
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads consuming a FIFO of jobs. Jobs still queued when the
+// pool is destroyed are run before the threads are joined, so whatever they
+// reference must outlive the pool.
+class worker_pool {
+  public:
+    explicit worker_pool(unsigned n = std::thread::hardware_concurrency())
+    {
+        if (n == 0)
+            n = 1;
+        for (unsigned i = 0; i < n; i++)
+            threads.emplace_back(&worker_pool::run, this);
+    }
+
+    ~worker_pool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(m);
+            stop = true;
+        }
+        cv.notify_all();
+        for (std::thread &t : threads)
+            t.join();
+    }
+
+    worker_pool(const worker_pool&) = delete;
+    worker_pool& operator=(const worker_pool&) = delete;
+
+    unsigned size() const { return threads.size(); }
+
+    void submit(std::function<void()> job)
+    {
+        {
+            std::lock_guard<std::mutex> guard(m);
+            jobs.push_back(std::move(job));
+        }
+        cv.notify_one();
+    }
+
+  private:
+    void run()
+    {
+        for (;;)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(m);
+                cv.wait(lock, [this] { return stop || !jobs.empty(); });
+                if (jobs.empty())
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> jobs;
+    std::mutex m;
+    std::condition_variable cv;
+    bool stop = false;
+};
+
+#endif /* H_CAMGAZEBO_WORKER_POOL */
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include <gazebo/common/Events.hh>
+#include <gazebo/common/Plugin.hh>
+#include <gazebo/physics/physics.hh>
+#include <gazebo/sensors/sensors.hh>
+#include <gazebo/transport/transport.hh>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace gazebo {
+
+// World plugin applying the camera requests camgazebo publishes when its
+// sensor control is on (see set_sensor_control):
+//
+//   <plugin name="camgazebo_sensor_control" filename="libcamgazebo_sensor_control.so">
+//     <topic>~/sensor</topic>
+//   </plugin>
+//
+// Each msgs::Sensor names a camera sensor and its parent link. always_on
+// is the requested activation, applied with Sensor::SetActive; an update
+// rate of 0 or none restores the sdf one. An image size or format other
+// than the rendered one recreates the sensor from the sdf of its link,
+// gazebo cameras cannot be resized in place. Requests are applied from
+// the world update, not the transport thread.
+class CamgazeboSensorControl : public WorldPlugin {
+  public:
+    void Load(physics::WorldPtr world, sdf::ElementPtr sdf) override
+    {
+        this->world = world;
+
+        std::string topic = "~/sensor";
+        if (sdf->HasElement("topic"))
+            topic = sdf->Get<std::string>("topic");
+
+        node = transport::NodePtr(new transport::Node());
+        node->Init(world->Name());
+        sub = node->Subscribe(topic, &CamgazeboSensorControl::OnRequest, this);
+        update = event::Events::ConnectWorldUpdateBegin(
+            std::bind(&CamgazeboSensorControl::OnUpdate, this));
+
+        gzmsg << "camgazebo sensor control on " << topic << "\n";
+    }
+
+  private:
+    void OnRequest(ConstSensorPtr& msg)
+    {
+        std::lock_guard<std::mutex> guard(m);
+        pending.push_back(*msg);
+    }
+
+    void OnUpdate()
+    {
+        std::vector<msgs::Sensor> requests;
+        {
+            std::lock_guard<std::mutex> guard(m);
+            requests.swap(pending);
+        }
+        for (const msgs::Sensor& r : requests)
+            Apply(r);
+    }
+
+    // the sdf element the sensor was loaded from
+    sdf::ElementPtr SensorSdf(const sensors::SensorPtr& s)
+    {
+        physics::EntityPtr parent = world->EntityByName(s->ParentName());
+        if (!parent || !parent->GetSDF()->HasElement("sensor"))
+            return sdf::ElementPtr();
+
+        for (sdf::ElementPtr e = parent->GetSDF()->GetElement("sensor"); e;
+             e = e->GetNextElement("sensor"))
+            if (e->Get<std::string>("name") == s->Name())
+                return e;
+        return sdf::ElementPtr();
+    }
+
+    void Apply(const msgs::Sensor& r)
+    {
+        sensors::SensorPtr s = sensors::get_sensor(world->Name() + "::" + r.parent() + "::" + r.name());
+        if (!s)
+            s = sensors::get_sensor(r.parent() + "::" + r.name());
+        sensors::CameraSensorPtr camera = std::dynamic_pointer_cast<sensors::CameraSensor>(s);
+        if (!camera)
+        {
+            gzwarn << "camgazebo: no camera sensor " << r.parent() << "::" << r.name() << "\n";
+            return;
+        }
+
+        // 0 restores the sdf rate, when the sdf is at hand
+        sdf::ElementPtr elem = SensorSdf(s);
+        bool sdf_rate = r.update_rate() <= 0 && elem;
+        double rate = sdf_rate ? elem->Get<double>("update_rate") : r.update_rate();
+
+        bool resize = r.has_camera() && r.camera().has_image_size() && (
+            (unsigned)r.camera().image_size().x() != camera->ImageWidth() ||
+            (unsigned)r.camera().image_size().y() != camera->ImageHeight() ||
+            r.camera().image_format() != camera->Camera()->ImageFormat());
+        if (!resize)
+        {
+            if (rate > 0 || sdf_rate)
+                s->SetUpdateRate(rate);
+            s->SetActive(r.always_on());
+            return;
+        }
+        if (!elem)
+        {
+            gzwarn << "camgazebo: no sdf for " << s->ScopedName() << ", cannot resize it\n";
+            return;
+        }
+
+        sdf::ElementPtr e = elem->Clone();
+        sdf::ElementPtr image = e->GetElement("camera")->GetElement("image");
+        image->GetElement("width")->Set((int)r.camera().image_size().x());
+        image->GetElement("height")->Set((int)r.camera().image_size().y());
+        image->GetElement("format")->Set(r.camera().image_format());
+        if (rate > 0 || sdf_rate)
+            e->GetElement("update_rate")->Set(rate);
+        e->GetElement("always_on")->Set(r.always_on());
+
+        // the new sensor advertises the same image topic
+        std::string parent = s->ParentName();
+        uint32_t parent_id = s->ParentId();
+        sensors::remove_sensor(s->ScopedName());
+        sensors::create_sensor(e, world->Name(), parent, parent_id);
+
+        gzmsg << "camgazebo: " << parent << "::" << r.name() << " renders at "
+              << r.camera().image_size().x() << "x" << r.camera().image_size().y()
+              << " " << r.camera().image_format() << "\n";
+    }
+
+    physics::WorldPtr world;
+    transport::NodePtr node;
+    transport::SubscriberPtr sub;
+    event::ConnectionPtr update;
+
+    std::mutex m;
+    std::vector<msgs::Sensor> pending;
+};
+
+GZ_REGISTER_WORLD_PLUGIN(CamgazeboSensorControl)
+
+}
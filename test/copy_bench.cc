@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include "accamgazebo.h"
+
+#include "copy.hpp"
+#include "dispatch.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Frame copy followed, or not, by a pass reading the destination, as the
+// publication stages do on the raw port frame. Streaming stores make the
+// copy alone cheaper but leave the destination out of the caches for the
+// readers.
+
+static volatile uint64_t sink;
+
+static void
+read_pass(const uint8_t* p, size_t n)
+{
+    uint64_t s = 0;
+    for (size_t i = 0; i < n; i += 8)
+    {
+        uint64_t v;
+        memcpy(&v, p + i, sizeof(v));
+        s += v;
+    }
+    sink = s;
+}
+
+// mean time (ms) of a copy of n bytes, with the read pass if read
+template <typename F>
+static double
+run(F copy, uint8_t* dst, const uint8_t* src, size_t n, bool read)
+{
+    const int rounds = 50;
+    copy(dst, src, n);
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        copy(dst, src, n);
+        if (read)
+            read_pass(dst, n);
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() / rounds;
+}
+
+int
+main()
+{
+    struct { const char* name; size_t n; } sizes[] = {
+        { "640x480 rgb", 640 * 480 * 3 },
+        { "1280x720 rgb", 1280 * 720 * 3 },
+        { "1920x1080 rgb", 1920 * 1080 * 3 },
+    };
+
+    isa_select(camgazebo_isa_auto);
+    printf("stream_copy: %s\n", isa_name(kernels.isa));
+    printf("%-14s %10s %10s %14s %14s\n", "frame", "memcpy", "stream", "memcpy+read", "stream+read");
+
+    for (const auto& s : sizes)
+    {
+        std::vector<uint8_t> src(s.n, 1), dst(s.n);
+        auto plain = [](void* d, const void* p, size_t n) { memcpy(d, p, n); };
+        auto stream = [](void* d, const void* p, size_t n) { kernels.stream_copy(d, p, n); };
+
+        printf("%-14s %8.3fms %8.3fms %12.3fms %12.3fms\n", s.name,
+               run(plain, dst.data(), src.data(), s.n, false),
+               run(stream, dst.data(), src.data(), s.n, false),
+               run(plain, dst.data(), src.data(), s.n, true),
+               run(stream, dst.data(), src.data(), s.n, true));
+    }
+    return 0;
+}
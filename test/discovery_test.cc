@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include "accamgazebo.h"
+
+#include "check.h"
+#include "discovery.hpp"
+
+#include <gazebo/Master.hh>
+#include <gazebo/common/Image.hh>
+#include <gazebo/msgs/msgs.hh>
+#include <gazebo/transport/transport.hh>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+// Camera discovery through an in process gazebo master: one stand-in
+// camera publishes frames, another one is advertised but silent.
+
+static const camgazebo_camera_topic*
+find(const sequence64_camgazebo_camera_topic& cameras, const char* suffix)
+{
+    for (uint32_t i = 0; i < cameras._length; i++)
+    {
+        size_t n = strlen(cameras._buffer[i].topic), m = strlen(suffix);
+        if (n >= m && !strcmp(cameras._buffer[i].topic + n - m, suffix))
+            return &cameras._buffer[i];
+    }
+    return NULL;
+}
+
+int
+main()
+{
+    uint16_t port = free_port();
+    gazebo::Master master;
+    master.Init(port);
+    master.RunThread();
+
+    if (!gazebo::transport::init("127.0.0.1", port))
+    {
+        fprintf(stderr, "no transport to the stand-in master on port %u\n", port);
+        master.Fini();
+        return 99;
+    }
+    gazebo::transport::run();
+
+    gazebo::transport::NodePtr node(new gazebo::transport::Node());
+    node->Init("camgazebo_test");
+    gazebo::transport::PublisherPtr live =
+        node->Advertise<gazebo::msgs::ImageStamped>("~/box/link/front/image");
+    gazebo::transport::PublisherPtr silent =
+        node->Advertise<gazebo::msgs::ImageStamped>("~/box/link/rear/image");
+
+    gazebo::msgs::ImageStamped frame;
+    frame.mutable_time()->set_sec(1);
+    frame.mutable_time()->set_nsec(0);
+    frame.mutable_image()->set_width(4);
+    frame.mutable_image()->set_height(2);
+    frame.mutable_image()->set_pixel_format(gazebo::common::Image::L_INT8);
+    frame.mutable_image()->set_step(4);
+    frame.mutable_image()->set_data(std::string(8, '\0'));
+
+    // keeps publishing after the listing, for callbacks coming late
+    std::atomic<bool> running{true};
+    std::thread camera([&] {
+        while (running)
+        {
+            live->Publish(frame);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    });
+
+    sequence64_camgazebo_camera_topic cameras;
+    cameras._maximum = 64;
+    cameras._length = 0;
+
+    // the probe gives up on the silent camera and returns
+    list_camera_topics(&cameras, 0.5);
+    check(cameras._length == 2);
+    const camgazebo_camera_topic* f = find(cameras, "/box/link/front/image");
+    const camgazebo_camera_topic* r = find(cameras, "/box/link/rear/image");
+    check(f && f->width == 4 && f->height == 2 && !strcmp(f->format, "L_INT8"));
+    check(r && r->width == 0 && r->height == 0 && !r->format[0]);
+
+    // listing only
+    list_camera_topics(&cameras, 0);
+    check(cameras._length == 2);
+    f = find(cameras, "/box/link/front/image");
+    check(f && f->width == 0);
+
+    // late frames reach no released probe
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    running = false;
+    camera.join();
+    live.reset();
+    silent.reset();
+    node.reset();
+    gazebo::transport::fini();
+    master.Fini();
+
+    return failed ? 1 : 0;
+}
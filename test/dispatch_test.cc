@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include "accamgazebo.h"
+
+#include "check.h"
+#include "dispatch.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Every kernel level the cpu supports against the scalar kernels, on odd
+// lengths and unaligned buffers so that both the vector bodies and their
+// scalar tails run.
+
+static const size_t lengths[] = { 0, 1, 3, 15, 16, 17, 63, 64, 65, 255, 257, 1000, 4099 };
+static const size_t offsets[] = { 0, 1, 3, 17, 33 };
+
+static void
+check_level(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b,
+            const std::vector<float>& f)
+{
+    for (size_t n : lengths)
+        for (size_t off : offsets)
+        {
+            // copies land at an unaligned offset, guard bytes around them
+            // are left alone
+            std::vector<uint8_t> dst(n + 128, 0xa5);
+            kernels.stream_copy(dst.data() + off, a.data() + 1, n);
+            check(!memcmp(dst.data() + off, a.data() + 1, n));
+            bool guards = true;
+            for (size_t i = 0; i < dst.size(); i++)
+                if ((i < off || i >= off + n) && dst[i] != 0xa5)
+                    guards = false;
+            check(guards);
+
+            check(kernels.sad(a.data() + off, b.data() + 2 * off, n)
+                  == sad_scalar(a.data() + off, b.data() + 2 * off, n));
+
+            std::vector<float> acc(f.begin(), f.begin() + n + off), ref(acc);
+            kernels.row_accumulate(acc.data() + off, a.data() + off, 0.37f, n);
+            row_accumulate_scalar(ref.data() + off, a.data() + off, 0.37f, n);
+            bool close = true;
+            for (size_t i = 0; i < acc.size(); i++)
+                if (std::fabs(acc[i] - ref[i]) > 1e-5f * std::fmax(1.f, std::fabs(ref[i])))
+                    close = false;
+            check(close);
+
+            // packed points are compared bitwise, rgb included
+            const uint32_t* rgb = (const uint32_t*)(const void*)b.data();
+            for (const uint32_t* c : { (const uint32_t*)nullptr, rgb })
+            {
+                size_t stride = c ? 4 : 3;
+                std::vector<float> out(n * stride + 1 + off), expected(out);
+                kernels.project_points(f.data() + off, f.data() + 1, f.data() + 2, c, n, out.data() + off);
+                project_points_scalar(f.data() + off, f.data() + 1, f.data() + 2, c, n, expected.data() + off);
+                check(!memcmp(out.data() + off, expected.data() + off, n * stride * sizeof(float)));
+            }
+        }
+}
+
+int
+main()
+{
+    srand(1);
+    std::vector<uint8_t> a(8192), b(32768);
+    std::vector<float> f(8192);
+    for (uint8_t& v : a)
+        v = rand();
+    for (uint8_t& v : b)
+        v = rand();
+    for (float& v : f)
+        v = (rand() - RAND_MAX / 2) / 1e6f;
+
+    int levels = 0;
+    for (camgazebo_isa isa : { camgazebo_isa_scalar, camgazebo_isa_sse2, camgazebo_isa_avx2,
+                               camgazebo_isa_avx512, camgazebo_isa_neon })
+    {
+        if (!isa_select(isa))
+            continue;
+        check(kernels.isa == isa);
+        check_level(a, b, f);
+        printf("%s kernels checked\n", isa_name(isa));
+        levels++;
+    }
+    check(levels > 0);
+
+    check(isa_select(camgazebo_isa_auto) && kernels.isa == isa_detect());
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include "accamgazebo.h"
+
+#include "check.h"
+#include "fanout.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+// Frame server checks over a local socket: the path is only taken over
+// from a stale socket, clients receive the frames they asked for at their
+// own rate, a client that does not keep up loses its oldest frames, and
+// clients with the same settings share a single encode.
+
+// a connected client that sent settings, reads time out after 2s
+static int
+connect_to(const char* path, const char* settings)
+{
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd != -1 && connect(fd, (sockaddr*)&addr, sizeof(addr)) == -1)
+    {
+        close(fd);
+        return -1;
+    }
+
+    timeval tv = { 2, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (send(fd, settings, strlen(settings), 0) != (ssize_t)strlen(settings))
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool
+read_all(int fd, void* buf, size_t n)
+{
+    for (size_t got = 0; got < n;)
+    {
+        ssize_t r = recv(fd, (char*)buf + got, n - got, 0);
+        if (r <= 0)
+            return false;
+        got += r;
+    }
+    return true;
+}
+
+static bool
+read_frame(int fd, fanout_header& hdr, std::vector<uint8_t>& payload)
+{
+    if (!read_all(fd, &hdr, sizeof(hdr)))
+        return false;
+    payload.resize(hdr.length);
+    return read_all(fd, payload.data(), payload.size());
+}
+
+// wait for n clients, and for the server to read their settings
+static bool
+wait_clients(camgazebo_fanout_s& server, uint32_t n)
+{
+    for (int i = 0; i < 200 && server.clients != n; i++)
+        usleep(10000);
+    usleep(100000);
+    return server.clients == n;
+}
+
+static void
+push_frame(camgazebo_fanout_s& server, std::vector<uint8_t>& pixels, uint16_t w, uint16_t h,
+           uint32_t seq)
+{
+    for (size_t i = 0; i < pixels.size(); i++)
+        pixels[i] = i + seq;
+    server.push(frame_view(pixels.data(), w, h, 3, 1, frame_view::scratch), { (int32_t)seq, 34 }, seq);
+}
+
+int
+main()
+{
+    char dir[] = "/tmp/camgazebo-fanout-XXXXXX";
+    if (!mkdtemp(dir))
+    {
+        perror("mkdtemp");
+        return 99;
+    }
+    std::string path = std::string(dir) + "/frames";
+    struct stat st;
+
+    // a regular file is not removed
+    FILE* f = fopen(path.c_str(), "w");
+    fclose(f);
+    {
+        camgazebo_fanout_s server;
+        check(!server.start(path.c_str()) && errno == EADDRINUSE);
+        check(lstat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode));
+    }
+    unlink(path.c_str());
+
+    // a socket left bound by a dead process is replaced
+    {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path.c_str());
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        check(bind(fd, (sockaddr*)&addr, sizeof(addr)) == 0);
+        close(fd);
+    }
+
+    camgazebo_fanout_s server;
+    check(server.start(path.c_str()));
+
+    // a socket still served is not taken over
+    {
+        camgazebo_fanout_s other;
+        check(!other.start(path.c_str()) && errno == EADDRINUSE);
+    }
+
+    uint16_t w = 8, h = 4;
+    std::vector<uint8_t> pixels(w * h * 3);
+    fanout_header hdr;
+    std::vector<uint8_t> payload;
+
+    int c = connect_to(path.c_str(), "rate=0 codec=raw\n");
+    check(c != -1);
+    check(wait_clients(server, 1));
+
+    push_frame(server, pixels, w, h, 7);
+    check(read_frame(c, hdr, payload));
+    check(!memcmp(hdr.magic, "CGZF", 4));
+    check(hdr.codec == fanout_raw && hdr.seq == 7);
+    check(hdr.sec == 7 && hdr.nsec == 34);
+    check(hdr.width == w && hdr.height == h && hdr.bpp == 3);
+    check(payload == pixels);
+
+    // one encode per distinct codec among the clients
+    int same = connect_to(path.c_str(), "rate=0 codec=raw\n");
+    int png = connect_to(path.c_str(), "rate=0 codec=png\n");
+    check(wait_clients(server, 3));
+
+    uint32_t encodes = server.encodes;
+    push_frame(server, pixels, w, h, 8);
+    check(read_frame(c, hdr, payload) && hdr.seq == 8 && payload == pixels);
+    check(read_frame(same, hdr, payload) && hdr.seq == 8 && payload == pixels);
+    check(read_frame(png, hdr, payload) && hdr.seq == 8 && hdr.codec == fanout_png);
+    check(server.encodes - encodes == 2);
+    close(same);
+    close(png);
+
+    // a 2 Hz client gets the first of frames pushed over 300 ms, the
+    // other one all of them
+    int slow = connect_to(path.c_str(), "rate=2 codec=raw\n");
+    check(wait_clients(server, 2));
+
+    for (uint32_t seq = 10; seq < 20; seq++)
+    {
+        push_frame(server, pixels, w, h, seq);
+        usleep(30000);
+    }
+    int fast_frames = 0;
+    while (read_frame(c, hdr, payload) && hdr.seq < 19)
+        fast_frames++;
+    check(hdr.seq == 19 && fast_frames >= 5);
+
+    check(read_frame(slow, hdr, payload) && hdr.seq == 10);
+    timeval poll_tv = { 0, 100000 };
+    setsockopt(slow, SOL_SOCKET, SO_RCVTIMEO, &poll_tv, sizeof(poll_tv));
+    check(!read_frame(slow, hdr, payload));
+    close(slow);
+    close(c);
+
+    // frames larger than the socket buffer pile up for a client that does
+    // not read; the oldest are dropped, the newest delivered
+    int stalled = connect_to(path.c_str(), "rate=0 codec=raw\n");
+    check(wait_clients(server, 1));
+
+    w = 512;
+    h = 512;
+    pixels.resize(w * h * 3);
+    uint32_t dropped = server.dropped;
+    for (uint32_t seq = 20; seq < 30; seq++)
+    {
+        push_frame(server, pixels, w, h, seq);
+        usleep(20000);
+    }
+    check(server.dropped - dropped > 0);
+
+    std::vector<uint32_t> received;
+    while (read_frame(stalled, hdr, payload))
+    {
+        received.push_back(hdr.seq);
+        if (hdr.seq == 29)
+            break;
+    }
+    check(!received.empty() && received.back() == 29);
+    check(received.size() <= camgazebo_fanout_s::queue_depth + 1);
+    for (size_t i = 1; i < received.size(); i++)
+        check(received[i] > received[i - 1]);
+    check(payload == pixels);
+    close(stalled);
+
+    server.stop();
+    check(lstat(path.c_str(), &st) == -1);
+    rmdir(dir);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include "accamgazebo.h"
+
+#include "check.h"
+#include "label_codec.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Label codec round trips, for every pixel size a label image may have:
+// run-length and palette encodings decode to the original pixels, and the
+// palette is refused past 256 labels.
+
+// n pixels of bpp bytes in runs of 1 to 300 pixels, among labels distinct
+// labels spread over the bytes of a pixel
+static std::vector<uint8_t>
+label_image(size_t n, unsigned bpp, unsigned labels)
+{
+    std::vector<uint8_t> img(n * bpp);
+    size_t i = 0;
+    while (i < n)
+    {
+        uint64_t v = (uint64_t)(rand() % labels) * 0x0101010101010101ULL;
+        for (size_t j = i + 1 + rand() % 300; i < n && i < j; i++)
+            memcpy(&img[i * bpp], &v, bpp);
+    }
+    return img;
+}
+
+static bool
+round_trip(label_codec_type codec, const std::vector<uint8_t>& img, unsigned bpp)
+{
+    size_t n = img.size() / bpp;
+    std::vector<uint8_t> enc(label_encode_bound(n, bpp));
+    size_t len = label_encode(codec, img.data(), n, bpp, enc.data());
+    if (!len)
+        return false;
+
+    std::vector<uint8_t> dec(img.size() + bpp);
+    return label_decode(enc.data(), len, dec.data(), n) == n
+        && !memcmp(dec.data(), img.data(), img.size())
+        && !label_decode(enc.data(), len - 1, dec.data(), n)
+        && !label_decode(enc.data(), len, dec.data(), n - 1);
+}
+
+int
+main()
+{
+    srand(1);
+
+    for (unsigned bpp = 1; bpp <= 6; bpp++)
+    {
+        std::vector<uint8_t> img = label_image(20000, bpp, 200);
+        check(round_trip(label_rle, img, bpp));
+        check(round_trip(label_palette, img, bpp));
+
+        // every pixel its own run
+        std::vector<uint8_t> noise(257 * bpp);
+        for (size_t i = 0; i < 257; i++)
+        {
+            uint64_t v = i % 2 ? i / 2 : 255;
+            memcpy(&noise[i * bpp], &v, bpp);
+        }
+        check(round_trip(label_rle, noise, bpp));
+        check(round_trip(label_palette, noise, bpp));
+    }
+
+    // more than 256 labels fall back to run-length encoding
+    for (unsigned bpp = 2; bpp <= 6; bpp++)
+    {
+        std::vector<uint8_t> img(300 * bpp, 0);
+        for (size_t i = 0; i < 300; i++)
+        {
+            uint64_t v = i * 7919;
+            memcpy(&img[i * bpp], &v, bpp);
+        }
+        std::vector<uint8_t> enc(label_encode_bound(300, bpp));
+        check(!label_encode(label_palette, img.data(), 300, bpp, enc.data()));
+        check(round_trip(label_rle, img, bpp));
+
+        // the refused image leaves no label behind for the next one
+        std::vector<uint8_t> small = label_image(1000, bpp, 256);
+        check(round_trip(label_palette, small, bpp));
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2020 LAAS/CNRS
+ * All rights reserved.
+ *
+ * Redistribution  and  use  in  source  and binary  forms,  with  or  without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   1. Redistributions of  source  code must retain the  above copyright
+ *      notice and this list of conditions.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice and  this list of  conditions in the  documentation and/or
+ *      other materials provided with the distribution.
+ *
+ * THE SOFTWARE  IS PROVIDED "AS IS"  AND THE AUTHOR  DISCLAIMS ALL WARRANTIES
+ * WITH  REGARD   TO  THIS  SOFTWARE  INCLUDING  ALL   IMPLIED  WARRANTIES  OF
+ * MERCHANTABILITY AND  FITNESS.  IN NO EVENT  SHALL THE AUTHOR  BE LIABLE FOR
+ * ANY  SPECIAL, DIRECT,  INDIRECT, OR  CONSEQUENTIAL DAMAGES  OR  ANY DAMAGES
+ * WHATSOEVER  RESULTING FROM  LOSS OF  USE, DATA  OR PROFITS,  WHETHER  IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR  OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *                                                  Martin Jacquet - June 2020
+ */
+#include "accamgazebo.h"
+
+#include "check.h"
+#include "sensor.hpp"
+
+#include <gazebo/Master.hh>
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Sensor requests through an in process gazebo master, received by a
+// stand-in for the camgazebo_sensor_control world plugin.
+
+struct stand_in_plugin {
+    std::mutex m;
+    std::vector<gazebo::msgs::Sensor> requests;
+
+    void on_request(ConstSensorPtr& msg)
+    {
+        std::lock_guard<std::mutex> guard(m);
+        requests.push_back(*msg);
+    }
+
+    // the n-th request, waiting up to 3s for it
+    bool get(size_t n, gazebo::msgs::Sensor& r)
+    {
+        for (int i = 0; i < 300; i++)
+        {
+            {
+                std::lock_guard<std::mutex> guard(m);
+                if (requests.size() > n)
+                {
+                    r = requests[n];
+                    return true;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return false;
+    }
+};
+
+int
+main()
+{
+    uint16_t port = free_port();
+    gazebo::Master master;
+    master.Init(port);
+    master.RunThread();
+
+    if (!gazebo::transport::init("127.0.0.1", port))
+    {
+        fprintf(stderr, "no transport to the stand-in master on port %u\n", port);
+        master.Fini();
+        return 99;
+    }
+    gazebo::transport::run();
+
+    gazebo::transport::NodePtr node(new gazebo::transport::Node());
+    node->Init("camgazebo_test");
+
+    stand_in_plugin plugin;
+    gazebo::transport::SubscriberPtr sub =
+        node->Subscribe("~/sensor", &stand_in_plugin::on_request, &plugin);
+
+    camgazebo_sensor_s sensor;
+    check(!sensor.attach(node, "~/image"));
+    check(sensor.attach(node, "/gazebo/camgazebo_test/box/link/camera/image"));
+    check(sensor.name == "camera" && sensor.parent == "box::link");
+
+    gazebo::msgs::Sensor r;
+    sensor.request(true, 10);
+    check(plugin.get(0, r));
+    check(r.name() == "camera" && r.parent() == "box::link" && r.type() == "camera");
+    check(r.always_on() && r.update_rate() == 10);
+    check(!r.has_camera());
+
+    // image settings are kept for later requests
+    sensor.request_image(640, 480, "L8");
+    check(plugin.get(1, r));
+    check(r.always_on() && r.update_rate() == 10);
+    check(r.has_camera() && r.camera().image_size().x() == 640 &&
+          r.camera().image_size().y() == 480 && r.camera().image_format() == "L8");
+
+    // inactive, back to the sdf rate
+    sensor.request(false, 0, true);
+    check(plugin.get(2, r));
+    check(!r.always_on() && r.update_rate() == 0);
+    check(r.has_camera() && r.camera().image_size().x() == 640);
+    check(sensor.requests == 3);
+
+    sensor.detach();
+    sub.reset();
+    node.reset();
+    gazebo::transport::fini();
+    master.Fini();
+
+    return failed ? 1 : 0;
+}